@@ -14,6 +14,13 @@ assimp          - https://github.com/assimp/assimp
 #include <set>
 #include <array>
 #include <map>
+#include <string>
+#include <new>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <future>
+#include <chrono>
 
 namespace gll
 {
@@ -22,23 +29,165 @@ namespace gll
 
     struct image
     {
-        size_t      width;
-        size_t      height;
-        uint8_t     color_channels;
+        enum class component_type
+        {
+            uint8               = 0,
+            uint16              = 1,
+            float32             = 2     //linear, hdr files keep their range
+        };
+
+        size_t          width;
+        size_t          height;
+        uint8_t         color_channels;
+        component_type  type = component_type::uint8;
         
-        void*       pixel_data;
-        size_t      pixel_data_size;
+        void*           pixel_data;
+        size_t          pixel_data_size;    //in bytes
+
+        //Set when pixel_data points into a copy on write mapping of a cooked image
+        void*           mapping         = nullptr;
+        size_t          mapping_size    = 0;
+
+        //Levels of the mip chain, level 0 is the image itself. The levels are stored one after
+        //another in pixel_data, so pixel_data_size covers the whole chain. Empty without mips.
+        struct mip_level
+        {
+            size_t  width;
+            size_t  height;
+            size_t  offset;     //in bytes, from pixel_data
+            size_t  size;       //in bytes
+        };
+
+        std::vector<mip_level>  mips;
+        bool                    allocated = false;      //pixel_data was allocated by gll, e.g. for the mip chain
+
+        static constexpr size_t storage_alignment = 64;
+    };
+
+    enum class mip_filter
+    {
+        box     = 0,    //2x2 average
+        kaiser  = 1     //Kaiser windowed sinc over 6x6 pixels, sharper than box
+    };
+
+    struct mip_settings
+    {
+        mip_filter  filter  = mip_filter::box;
+        bool        srgb    = true;     //uint8 color is filtered in linear space; alpha, uint16 and float32 always are
+        size_t      levels  = 0;        //0 - down to 1x1
     };
 
     struct image_load_settings
     {
-        bool flip_vertically    = true;
+        bool    flip_vertically     = true;
+        bool    memory_map          = false;    //decode path based loads from a memory mapping of the file
+        uint8_t channels            = 0;        //0 - as stored in the file, 1 to 4 - converted to this count
+
+        //Pixels are converted when the file stores another type, 8 bit files are gamma decoded into float32
+        image::component_type type  = image::component_type::uint8;
+
+        bool            build_mips  = false;
+        mip_settings    mips;
+
+        //When set, path based loads keep the decoded pixels in this directory, keyed by the source path,
+        //its modification time and size, and these settings. Later loads of an unchanged source map the
+        //cooked pixels instead of decoding them again.
+        std::string cache_directory;
+
+        //load_images only
+        size_t  worker_threads      = 0;    //0 - std::thread::hardware_concurrency()
+        size_t  max_inflight_bytes  = 0;    //0 - unlimited; decoded bytes not yet handed to the caller
     };
 
     //jpeg, png, tga, bmp, psd, gif, hdr, pic, pnm
     result<image> load_image(const char* filepath, const image_load_settings& settings);
+    result<image> load_image(const void* data, size_t size, const image_load_settings& settings);
+
+    //Decodes the images concurrently, results are in the order of filepaths
+    std::vector<result<image>> load_images(const std::vector<const char*>& filepaths, const image_load_settings& settings);
+
+    //Decodes the images concurrently and hands each one to on_loaded in the order of filepaths.
+    //on_loaded is called from the worker threads, one call at a time; the decoded bytes count
+    //towards settings.max_inflight_bytes until on_loaded returns.
+    void load_images(
+        const std::vector<const char*>&                         filepaths,
+        const image_load_settings&                              settings,
+        const std::function<void(size_t, result<image>&)>&      on_loaded
+    );
+
     void free_image(image& img);
 
+    //Replaces the pixels with the mip chain built from level 0, see image::mips
+    bool generate_mips(image& img, const mip_settings& settings);
+
+    //Rows of an image being streamed, laid out as load_image would lay them out
+    struct image_band
+    {
+        size_t                  width;
+        size_t                  height;         //of the whole image
+        uint8_t                 color_channels;
+        image::component_type   type;
+        size_t                  first_row;      //in the whole image, after flip_vertically
+        size_t                  rows;
+        const void*             pixels;         //valid until on_band returns
+    };
+
+    //Decodes the image in bands of up to band_rows rows and hands them to on_band in the order the file
+    //stores them, so first_row may go down. Non interlaced png, 8 and 24 bit uncompressed bmp and 8, 24
+    //and 32 bit tga files are decoded row by row and only one band is held in memory; other files are
+    //decoded whole first. Returns false on errors or once on_band returns false, which stops the decode.
+    //Mips and the cache are not used.
+    bool load_image_streamed(
+        const char*                                     filepath,
+        const image_load_settings&                      settings,
+        size_t                                          band_rows,
+        const std::function<bool(const image_band&)>&   on_band
+    );
+
+    //Block compression
+    enum class block_format
+    {
+        bc1     = 0,    //rgb, 8 bytes per block
+        bc3     = 1,    //rgba, 16 bytes per block
+        bc5     = 2,    //the first two channels as stored, 16 bytes per block
+        bc7     = 3     //rgba, 16 bytes per block
+    };
+
+    enum class compression_quality
+    {
+        fast    = 0,
+        normal  = 1,
+        high    = 2
+    };
+
+    struct compression_settings
+    {
+        block_format        format          = block_format::bc7;
+        compression_quality quality         = compression_quality::normal;
+        size_t              worker_threads  = 0;    //0 - std::thread::hardware_concurrency()
+    };
+
+    //Blocks of every mip level one after another, mips describe the levels in pixels and their blocks in bytes
+    struct compressed_image
+    {
+        block_format                    format;
+        size_t                          width;
+        size_t                          height;
+        std::vector<image::mip_level>   mips;
+        std::vector<uint8_t>            blocks;
+    };
+
+    //Compresses uint8 images, with their mip chains if they have one. Grey images are expanded to rgb.
+    result<compressed_image> compress_image(const image& img, const compression_settings& settings);
+
+    //Loads and compresses the image. With image_settings.cache_directory set, the blocks are cooked next to
+    //the cooked images and loaded from there while the source is unchanged.
+    result<compressed_image> load_compressed_image(
+        const char*                 filepath,
+        const image_load_settings&  image_settings,
+        const compression_settings& settings
+    );
+
     struct model
     {
         enum class attribute
@@ -51,14 +200,112 @@ namespace gll
             bones_weights       = 5
         };
 
+        enum class component_type
+        {
+            float32             = 0,
+            uint32              = 1,
+            uint16              = 2,
+            uint8               = 3
+        };
+
+        enum class primitive_type
+        {
+            triangles           = 0,
+            points              = 1,
+            lines               = 2,
+            mixed               = 3     //points, lines and triangles in one index buffer
+        };
+
+        //Describes where an attribute lives inside mesh::storage
+        struct attribute_layout
+        {
+            attribute       attrib;
+            size_t          offset;         //in bytes, from the beginning of storage
+            size_t          stride;         //in bytes, between consecutive vertices
+            uint8_t         components;
+            component_type  type;
+        };
+
+        //Axis aligned box of the positions and the sphere around it centered on the box, all zero without positions
+        struct bounding_volume
+        {
+            std::array<float, 3>    min     = {};
+            std::array<float, 3>    max     = {};
+            std::array<float, 3>    center  = {};
+            float                   radius  = 0;
+        };
+
+        //Filled by the optional mesh processing passes
+        struct mesh_statistics
+        {
+            float   acmr_before = 0;    //average cache miss ratio, post transform cache misses per triangle
+            float   acmr_after  = 0;
+
+            size_t  vertices_before = 0;    //vertex counts before and after welding
+            size_t  vertices_after  = 0;
+        };
+
         struct mesh
         {
             std::set<attribute>             attributes;
             std::list<std::vector<float>>   vertices;
             std::vector<unsigned int>       indicies;
+            std::vector<uint16_t>           indicies_16;    //filled instead of indicies when indicies_type is uint16
+            component_type                  indicies_type = component_type::uint32;
             int                             material_id;
+            primitive_type                  primitives = primitive_type::triangles;
+            size_t                          vertices_count = 0;
+            mesh_statistics                 statistics;
+            bounding_volume                 bounds;         //of the positions, in the space of the mesh
+
+            //Bone ids of the bones_indices attribute, max_influencial_bones per vertex, are kept out of
+            //vertices as integers of bones_indices_type. Unused slots hold 0 with a weight of 0.
+            std::vector<uint8_t>            bones_indices;
+            component_type                  bones_indices_type = component_type::uint16;
+
+            //Simplified versions of the mesh, each an index buffer over the same vertices
+            struct lod
+            {
+                float                       ratio;      //triangles kept, relative to the mesh
+                float                       error;      //geometric error, relative to the mesh extent
+                std::vector<unsigned int>   indicies;   //always 32 bit and kept out of storage
+            };
+            std::vector<lod>                lods;
+
+            //Clusters of up to 256 vertices for mesh shading and cluster culling, see build_meshlets
+            struct meshlet
+            {
+                uint32_t                vertex_offset;      //into meshlet_vertices
+                uint32_t                triangle_offset;    //into meshlet_triangles
+                uint32_t                vertex_count;
+                uint32_t                triangle_count;
+
+                std::array<float, 3>    center;             //bounding sphere
+                float                   radius;
+
+                //The meshlet faces away from a camera when dot(normalize(cone_apex - camera), cone_axis) >= cone_cutoff.
+                //Without the apex, dot(center - camera, cone_axis) >= cone_cutoff * length(center - camera) + radius
+                //is also safe. The cutoff is 1 when the normals spread too wide.
+                std::array<float, 3>    cone_apex;
+                std::array<float, 3>    cone_axis;
+                float                   cone_cutoff;
+            };
+            std::vector<meshlet>            meshlets;
+            std::vector<unsigned int>       meshlet_vertices;   //indices of the vertices of every meshlet
+            std::vector<uint8_t>            meshlet_triangles;  //3 indices into the vertices of the meshlet per triangle
+
+            //Filled instead of vertices and indicies when model_load_settings::contiguous_storage is set.
+            //All attribute streams and the index buffer share one allocation aligned to storage_alignment.
+            void*                           storage = nullptr;
+            size_t                          storage_size = 0;
+            std::vector<attribute_layout>   layout;
+            size_t                          indicies_offset = 0;
+            size_t                          indicies_count = 0;
+
+            static constexpr size_t         storage_alignment = 64;
         };
 
+        //Offset matrices are in the y/z swapped space of the loaded vertices
         struct bone_info
         {
             int id;
@@ -68,265 +315,6115 @@ namespace gll
             std::array<float, 4> offset_matrix_row_3;
         };
 
+        //Transforms are row major, relative to the parent node and in the y/z swapped space of the loaded vertices
+        struct node
+        {
+            std::string                             name;
+            int                                     parent;     //-1 for the root
+            std::array<std::array<float, 4>, 4>     transform;
+            std::vector<unsigned int>               meshes;     //indices into model::meshes
+        };
+
         std::map<std::string, bone_info>    bones;
-        std::vector<mesh>                   meshes;
+        std::vector<mesh>                   meshes;     //every mesh once, however many nodes reference it
+        std::vector<node>                   nodes;      //parents come before their children, nodes[0] is the root
+        bounding_volume                     bounds;     //of every mesh as placed by the nodes referencing it
+
+        //Set when mesh storage points into a copy on write mapping of a cooked model
+        void*                               mapping         = nullptr;
+        size_t                              mapping_size    = 0;
+    };
+
+    //Assimp post processing applied on import
+    enum class pipeline_profile
+    {
+        standard        = 0,    //triangulate, generate smooth normals and tangents (see tangents_on_demand), flip uvs
+        fast_preview    = 1,    //triangulate and flip uvs only
+        custom          = 2     //postprocess_flags only
     };
 
     struct model_load_settings
     {
         bool                        interleave_attributes = true;
+        bool                        contiguous_storage = false;
+        bool                        compact_indicies = false;   //uint16 indicies for meshes with up to 65536 vertices
+        bool                        memory_map = false;         //Assimp reads path based loads through memory mappings
+        bool                        optimize_vertex_cache = false;
+        size_t                      vertex_cache_size = 32;
+        bool                        weld_vertices = false;      //see weld_vertices
+        float                       weld_epsilon = 0;
+        std::vector<float>          lod_ratios;                 //see generate_lods
+        bool                        build_meshlets = false;     //see build_meshlets
+        size_t                      meshlet_max_vertices = 64;
+        size_t                      meshlet_max_triangles = 124;
         int                         max_influencial_bones = 4;
+        model::component_type       bones_indices_type = model::component_type::uint16;  //uint8, uint16 or uint32
         std::set<model::attribute>  force_attributes;
+        size_t                      worker_threads = 0;     //0 - std::thread::hardware_concurrency()
+
+        pipeline_profile            profile = pipeline_profile::standard;
+        unsigned int                postprocess_flags = 0;          //aiPostProcessSteps added to the profile
+        bool                        join_identical_vertices = false;
+        bool                        improve_cache_locality = false; //Assimp's own reordering, for vertex_cache_size
+        bool                        sort_by_primitive_type = false; //splits points and lines into their own meshes
+
+        //Generates tangents only if tangents_bitangents is forced, tangents stored in the file are still loaded.
+        //Turn off to have tangents generated for every mesh with texcoords, as before.
+        bool                        tangents_on_demand = true;
+
+        //Bakes the node transforms into the vertices and merges meshes sharing a material and attribute set
+        //into a new root node. Skinned meshes stay on their nodes, which are kept along with the bone nodes.
+        bool                        flatten_static_batches = false;
+
+        //When set, path based loads keep a cooked copy of the output in this directory, keyed by the
+        //source path, its modification time and size, and these settings. Later loads of an unchanged
+        //source map the cooked file instead of importing it again.
+        std::string                 cache_directory;
     };
 
     result<model> load_model(const char* filepath, const model_load_settings& settings);
+
+    //format_hint is the file extension of the data, e.g. "fbx", used by Assimp to pick the importer.
+    //Files referenced by the data, like the .mtl of an .obj, cannot be resolved.
+    result<model> load_model(const void* data, size_t size, const char* format_hint, const model_load_settings& settings);
+
     void free_model(model& mod);
-}
 
-#ifndef GLL_IMPLEMENTATION
+    //Keeps one Assimp importer alive across loads, saving its setup for batches of small models.
+    //A loader is not thread safe, use one per thread.
+    class model_loader
+    {
+    public:
+        model_loader();
+        ~model_loader();
 
-using namespace gll;
+        model_loader(const model_loader&) = delete;
+        model_loader& operator=(const model_loader&) = delete;
 
-#include "stb/stb_image.hpp"
+        result<model> load(const char* filepath, const model_load_settings& settings);
+        result<model> load(const void* data, size_t size, const char* format_hint, const model_load_settings& settings);
 
-result<image> gll::load_image(const char* filepath, const image_load_settings& settings)
-{
-    stbi_set_flip_vertically_on_load_thread(settings.flip_vertically);
+    private:
+        struct state;
+        std::unique_ptr<state> impl;
+    };
 
-    image img;
-    int width, height, channels;
+    //Mesh processing
+    //These work on meshes in the default form: float vertices and 32 bit indicies of triangles, with
+    //mesh::primitives set to triangles, as loaded without compact_indicies and contiguous_storage.
+    //They return false for other meshes.
 
-    unsigned char* data = stbi_load(
-        filepath, 
-        &width, 
-        &height,
-        &channels,
-        0
-    );
+    //Reorders the triangles for post transform vertex cache locality and then the vertices in the
+    //order of first use, recording the average cache miss ratio before and after in mesh.statistics
+    bool optimize_vertex_cache(model::mesh& mesh, size_t cache_size = 32);
 
-    if (!data)
-        return {false, {}};
+    //Merges vertices whose attributes are equal and rewrites the indicies, recording the vertex counts in
+    //mesh.statistics. With an epsilon of 0 only bitwise equal vertices merge; otherwise every float is
+    //rounded to a multiple of epsilon first, so values closer than epsilon may still land apart.
+    //Unlike the other passes it takes any primitive type.
+    bool weld_vertices(model::mesh& mesh, float epsilon = 0);
 
-    img.width = width;
-    img.height = height;
-    img.color_channels = channels;
+    //Fills mesh.lods with one simplified level per ratio of triangles to keep, in decreasing order.
+    //Simplification stops early when no edge can collapse any more, leaving a higher ratio than asked.
+    bool generate_lods(model::mesh& mesh, const std::vector<float>& ratios);
 
-    img.pixel_data = data;
-    img.pixel_data_size = (img.width * img.height * img.color_channels * sizeof(float));
+    //Splits the triangles into meshlets of up to max_vertices (at most 256) vertices and max_triangles
+    //triangles, keeping neighbouring triangles together, and computes their bounding spheres and normal cones
+    bool build_meshlets(model::mesh& mesh, size_t max_vertices = 64, size_t max_triangles = 124);
 
-    return {true, std::move(img)};
-}
+    //Shared by an asynchronous load and its caller
+    struct load_progress
+    {
+        std::atomic<size_t> bytes_read{0};
+        std::atomic<size_t> meshes_converted{0};
+        std::atomic<size_t> meshes_total{0};        //known once the model file is imported
+        std::atomic<bool>   cancel_requested{false};
+    };
 
-void gll::free_image(image& img)
-{
-    stbi_image_free(img.pixel_data);
+    template<class T>
+    struct async_result
+    {
+        std::future<result<T>>          future;
+        std::shared_ptr<load_progress>  progress;
+
+        bool ready() const { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+        result<T> get() { return future.get(); }
+
+        //The load stops at its next check and yields {false, {}}
+        void cancel() { progress->cancel_requested = true; }
+    };
+
+    //Loads on a detached worker thread. on_complete, if given, is called on that thread before the result
+    //is made available through the future; it may take the result by moving from it.
+    async_result<image> load_image_async(
+        const char*                                 filepath,
+        const image_load_settings&                  settings,
+        std::function<void(result<image>&)>         on_complete = nullptr
+    );
+
+    async_result<model> load_model_async(
+        const char*                                 filepath,
+        const model_load_settings&                  settings,
+        std::function<void(result<model>&)>         on_complete = nullptr
+    );
 }
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#ifndef GLL_IMPLEMENTATION
 
-void process_assimp_vertex_attrib(
-    gll::model::mesh&           output,
-    size_t                      vertex_id,
-    gll::model::attribute       attrib,
-    aiMesh*                     mesh,
-    std::vector<float>*         target,
-    const model_load_settings&  settings
-)
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <cctype>
+
+using namespace gll;
+
+//SIMD kernels
+//Define GLL_NO_SIMD to force the scalar fallbacks.
+
+#if !defined(GLL_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define GLL_SSE2
+    #include <emmintrin.h>
+#endif
+
+#if !defined(GLL_NO_SIMD) && defined(__AVX2__)
+    #define GLL_AVX2
+    #include <immintrin.h>
+#endif
+
+//Bounding box of positions, accumulated by the loops that copy them so they are read only once
+struct bounds_accumulator
 {
-    switch (attrib)
+    float low[3]  = {INFINITY, INFINITY, INFINITY};
+    float high[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+    void add(const float* p)
     {
-    case model::attribute::position:
-        if (!mesh->HasPositions())              goto _process_assimp_vertex_attrib_push_zeros;
-        target->push_back(mesh->mVertices[vertex_id].x);
-        target->push_back(mesh->mVertices[vertex_id].z);
-        target->push_back(mesh->mVertices[vertex_id].y);
-        break;
-    case model::attribute::normal:
-        if (!mesh->HasNormals())                goto _process_assimp_vertex_attrib_push_zeros;
-        target->push_back(mesh->mNormals[vertex_id].x);
-        target->push_back(mesh->mNormals[vertex_id].z);
-        target->push_back(mesh->mNormals[vertex_id].y);
-        break;
-    case model::attribute::texcoord:
-        if (!mesh->HasTextureCoords(0))         goto _process_assimp_vertex_attrib_push_zeros;
-        target->push_back(mesh->mTextureCoords[0][vertex_id].x);
-        target->push_back(mesh->mTextureCoords[0][vertex_id].y);
-        break;
-    case model::attribute::tangents_bitangents:
-        if (!mesh->HasTangentsAndBitangents())  goto _process_assimp_vertex_attrib_push_zeros;
-        target->push_back(mesh->mTangents[vertex_id].x);
-        target->push_back(mesh->mTangents[vertex_id].z);
-        target->push_back(mesh->mTangents[vertex_id].y);
-        target->push_back(mesh->mBitangents[vertex_id].x);
-        target->push_back(mesh->mBitangents[vertex_id].z);
-        target->push_back(mesh->mBitangents[vertex_id].y);
-        break;
-    case model::attribute::bones_indices:
-        union {
-            float f;
-            int i;
-        } conversion;
-        conversion.i = -1;
-
-        for (int i = 0; i < settings.max_influencial_bones; i++)
-            target->push_back(conversion.f);
-        break;
-    case model::attribute::bones_weights:
-        for (int i = 0; i < settings.max_influencial_bones; i++)
-            target->push_back(0);
-        break;
+        for (size_t k = 0; k < 3; k++)
+        {
+            low[k] = std::min(low[k], p[k]);
+            high[k] = std::max(high[k], p[k]);
+        }
     }
-    return;
-    
-_process_assimp_vertex_attrib_push_zeros:
-    size_t count;
-    
-    if (attrib == model::attribute::texcoord)                   count = 2;
-    else if (attrib == model::attribute::tangents_bitangents)   count = 6;
-    else                                                        count = 3;
-                    
-    for (int i = 0; i < count; i++)
-        target->push_back(0);
-    return;
-}
 
-void process_assimp_mesh(
-    model&                      output, 
-    const model_load_settings&  settings,
-    aiMesh*                     mesh
-)
+    //Lanes of tightly packed positions starting at an x, as minimums and maximums of the same lanes
+    void add_lanes(const float* lanes_low, const float* lanes_high, size_t count)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            low[j % 3] = std::min(low[j % 3], lanes_low[j]);
+            high[j % 3] = std::max(high[j % 3], lanes_high[j]);
+        }
+    }
+
+    //The sphere is centered on the box and reaches its corners
+    void finish(model::bounding_volume& output) const
+    {
+        output = {};
+        if (low[0] > high[0])
+            return;
+
+        float radius = 0;
+        for (size_t k = 0; k < 3; k++)
+        {
+            output.min[k] = low[k];
+            output.max[k] = high[k];
+            output.center[k] = (low[k] + high[k]) * 0.5f;
+            radius += (high[k] - low[k]) * (high[k] - low[k]);
+        }
+        output.radius = std::sqrt(radius) * 0.5f;
+    }
+};
+
+//Writes (x, z, y) for every (x, y, z) of a tightly packed vec3 array into a tightly packed vec3 array.
+//When bounds is given, the written vectors are added to it.
+void swizzle_yz_vec3(const float* src, float* dst, size_t count, bounds_accumulator* bounds = nullptr)
 {
-    //Create mesh
+    auto swizzle_one = [&](size_t i){
+        dst[i * 3 + 0] = src[i * 3 + 0];
+        dst[i * 3 + 1] = src[i * 3 + 2];
+        dst[i * 3 + 2] = src[i * 3 + 1];
+        if (bounds)
+            bounds->add(dst + i * 3);
+    };
 
-    output.meshes.push_back({});
-    auto& outmesh = output.meshes.back();
-    outmesh.material_id = mesh->mMaterialIndex;
+    size_t i = 0;
 
-    //Load Indicies
-    
-    for (unsigned int face_id = 0; face_id < mesh->mNumFaces; face_id++)
+#if defined(GLL_AVX2)
+    //8 vertices (24 floats) per iteration. Apart from output float 7 and 8, which cross
+    //the 8 float chunks boundary, each chunk is a permutation of the matching input chunk.
+    const __m256i chunk_0 = _mm256_setr_epi32(0, 2, 1, 3, 5, 4, 6, 0);
+    const __m256i chunk_1 = _mm256_setr_epi32(0, 1, 3, 2, 4, 6, 5, 7);
+    const __m256i chunk_2 = _mm256_setr_epi32(1, 0, 2, 4, 3, 5, 7, 6);
+    const __m256i first   = _mm256_set1_epi32(0);
+    const __m256i last    = _mm256_set1_epi32(7);
+
+    //Minimums and maximums of every lane of the 3 output chunks, sorted into components at the end
+    __m256 low[3], high[3];
+    for (size_t k = 0; k < 3; k++)
     {
-        auto face = mesh->mFaces[face_id];
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-            outmesh.indicies.push_back(face.mIndices[j]);
+        low[k] = _mm256_set1_ps(INFINITY);
+        high[k] = _mm256_set1_ps(-INFINITY);
     }
 
-    //Findout vertex layout
-
-    std::set<gll::model::attribute> model_attribs;
-    if (mesh->HasPositions())               model_attribs.insert(gll::model::attribute::position);
-    if (mesh->HasNormals())                 model_attribs.insert(gll::model::attribute::normal);
-    if (mesh->HasTextureCoords(0))          model_attribs.insert(gll::model::attribute::texcoord);
-    if (mesh->HasTangentsAndBitangents())   model_attribs.insert(gll::model::attribute::tangents_bitangents);
-    if (mesh->HasBones()) {
-        model_attribs.insert(gll::model::attribute::bones_indices);
-        model_attribs.insert(gll::model::attribute::bones_weights);
-    };
+    for (; i + 8 <= count; i += 8)
+    {
+        const float* s = src + i * 3;
+        float* d = dst + i * 3;
 
-    model_attribs.insert(
-        settings.force_attributes.begin(),
-        settings.force_attributes.end()
-    ); 
+        __m256 a = _mm256_loadu_ps(s + 0);
+        __m256 b = _mm256_loadu_ps(s + 8);
+        __m256 c = _mm256_loadu_ps(s + 16);
 
-    //Create containers for vertices
+        __m256 out[3] = {
+            _mm256_blend_ps(_mm256_permutevar8x32_ps(a, chunk_0), _mm256_permutevar8x32_ps(b, first), 0x80),
+            _mm256_blend_ps(_mm256_permutevar8x32_ps(b, chunk_1), _mm256_permutevar8x32_ps(a, last),  0x01),
+            _mm256_permutevar8x32_ps(c, chunk_2)
+        };
 
-    const size_t vertices_count = mesh->mNumVertices;
-    std::map<gll::model::attribute, std::vector<float>*> attribs_save_targets_map; 
+        for (size_t k = 0; k < 3; k++)
+        {
+            _mm256_storeu_ps(d + k * 8, out[k]);
+            low[k] = _mm256_min_ps(low[k], out[k]);
+            high[k] = _mm256_max_ps(high[k], out[k]);
+        }
+    }
 
-    auto elements_per_attrib = [&](gll::model::attribute attrib){
-        switch (attrib)
+    if (bounds)
+    {
+        float lanes_low[24], lanes_high[24];
+        for (size_t k = 0; k < 3; k++)
         {
-        case gll::model::attribute::position:              return 3;
-        case gll::model::attribute::normal:                return 3;
-        case gll::model::attribute::texcoord:              return 2;
-        case gll::model::attribute::tangents_bitangents:   return 6;
-        case gll::model::attribute::bones_indices:         return settings.max_influencial_bones;
-        case gll::model::attribute::bones_weights:         return settings.max_influencial_bones;
+            _mm256_storeu_ps(lanes_low + k * 8, low[k]);
+            _mm256_storeu_ps(lanes_high + k * 8, high[k]);
         }
-        return 0;
-    };
+        bounds->add_lanes(lanes_low, lanes_high, 24);
+    }
+#elif defined(GLL_SSE2)
+    //4 vertices per iteration: (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3) -> (x0 z0 y0 x1) (z1 y1 x2 z2) (y2 x3 z3 y3)
+    __m128 low[3], high[3];
+    for (size_t k = 0; k < 3; k++)
+    {
+        low[k] = _mm_set1_ps(INFINITY);
+        high[k] = _mm_set1_ps(-INFINITY);
+    }
 
-    if (settings.interleave_attributes)
+    for (; i + 4 <= count; i += 4)
     {
-        outmesh.vertices.push_back({});
-        auto& target = outmesh.vertices.back();
-        
-        size_t vertex_length = 0;
-        for (auto& attrib : model_attribs)
+        const float* s = src + i * 3;
+        float* d = dst + i * 3;
+
+        __m128 a = _mm_loadu_ps(s + 0);
+        __m128 b = _mm_loadu_ps(s + 4);
+        __m128 c = _mm_loadu_ps(s + 8);
+
+        __m128 bc_x = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 0, 2, 2));
+        __m128 bc_y = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 3, 3));
+
+        __m128 out[3] = {
+            _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 2, 0)),
+            _mm_shuffle_ps(b, bc_x, _MM_SHUFFLE(2, 0, 0, 1)),
+            _mm_shuffle_ps(bc_y, c, _MM_SHUFFLE(2, 3, 2, 0))
+        };
+
+        for (size_t k = 0; k < 3; k++)
         {
-            attribs_save_targets_map.insert({attrib, &target});
-            vertex_length += elements_per_attrib(attrib);
+            _mm_storeu_ps(d + k * 4, out[k]);
+            low[k] = _mm_min_ps(low[k], out[k]);
+            high[k] = _mm_max_ps(high[k], out[k]);
         }
-            
-        target.reserve(vertex_length * vertices_count);
     }
-    else
+
+    if (bounds)
     {
-        for (auto& attrib : model_attribs)
+        float lanes_low[12], lanes_high[12];
+        for (size_t k = 0; k < 3; k++)
         {
-            outmesh.vertices.push_back({});
-            auto& target = outmesh.vertices.back();
-            target.reserve(vertices_count * elements_per_attrib(attrib));
-            attribs_save_targets_map.insert({attrib, &target});
+            _mm_storeu_ps(lanes_low + k * 4, low[k]);
+            _mm_storeu_ps(lanes_high + k * 4, high[k]);
         }
+        bounds->add_lanes(lanes_low, lanes_high, 12);
     }
+#endif
 
-    outmesh.attributes = model_attribs;
+    for (; i < count; i++)
+        swizzle_one(i);
+}
 
-    //Load Vertices
+//Work stealing parallel for
+//Items are split into one contiguous range per worker. Each worker drains its own range
+//front to back and then steals the remaining items of the other ranges.
+
+struct parallel_for_range
+{
+    std::atomic<size_t> next;
+    size_t              end;
+};
+
+size_t resolve_worker_threads(size_t requested, size_t items)
+{
+    size_t threads = requested ? requested : std::thread::hardware_concurrency();
+    if (threads > items) threads = items;
+    return threads ? threads : 1;
+}
 
-    for (size_t vertex_id = 0; vertex_id < vertices_count; vertex_id++)
+//Persistent worker threads shared by every parallel section. The pool is created on first use and
+//grows to the largest thread count requested. A section hands out worker ids one at a time, and the
+//calling thread claims whatever ids the pool has not picked up yet, so nested sections never wait
+//on an idle id and a busy pool only costs parallelism. Asynchronous loads get threads of their own,
+//which the pool joins before it shuts down.
+
+struct worker_job
+{
+    void      (*invoke)(const void*, size_t);
+    const void* worker;
+    size_t      threads;
+    size_t      next_id = 1;    //id 0 always runs on the calling thread
+    size_t      running = 0;
+};
+
+class worker_pool
+{
+    std::mutex                  mutex;
+    std::condition_variable     wake;
+    std::condition_variable     finished;
+    std::list<worker_job*>      jobs;
+    std::vector<std::thread>    threads;
+    bool                        stopping = false;
+
+    struct background_thread
     {
-        for (auto& attrib : model_attribs)
+        std::thread                         thread;
+        std::shared_ptr<std::atomic<bool>>  done;
+    };
+    std::list<background_thread> background;
+
+    //Takes the next id of the job, must be called with the mutex held
+    size_t claim(worker_job& job)
+    {
+        const size_t id = job.next_id++;
+        if (job.next_id == job.threads)
+            jobs.remove(&job);
+        job.running++;
+        return id;
+    }
+
+    void execute(std::unique_lock<std::mutex>& lock, worker_job& job, size_t id)
+    {
+        lock.unlock();
+        job.invoke(job.worker, id);
+        lock.lock();
+
+        if (--job.running == 0)
+            finished.notify_all();
+    }
+
+    void thread_main()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
         {
-            process_assimp_vertex_attrib(
-                outmesh,
-                vertex_id,
-                attrib,
-                mesh,
-                attribs_save_targets_map[attrib],
-                settings
-            );
+            wake.wait(lock, [&]{ return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+
+            auto& job = *jobs.front();
+            execute(lock, job, claim(job));
         }
     }
-}
 
-void process_assimp_node(
-    model&          output, 
-    const model_load_settings& settings,
-    aiNode*         node,
-    const aiScene*  scene
-)
-{
-    for(unsigned int i = 0; i < node->mNumMeshes; i++)
+public:
+    static worker_pool& get()
     {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        process_assimp_mesh(output, settings, mesh);
+        static worker_pool pool;
+        return pool;
     }
-    
-    for(unsigned int i = 0; i < node->mNumChildren; i++)
-        process_assimp_node(output, settings, node->mChildren[i], scene);
-}
 
-result<model> gll::load_model(const char* filepath, const model_load_settings& settings)
-{
-    model output;
+    ~worker_pool()
+    {
+        //Loads still running use the workers, so they finish first
+        std::list<background_thread> loads;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            loads = std::move(background);
+        }
+        for (auto& load : loads)
+            load.thread.join();
 
-    Assimp::Importer import;
-    const aiScene *scene = import.ReadFile(filepath, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);	
-	
-    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) 
-        return {false, {}};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
 
-    process_assimp_node(output, settings, scene->mRootNode, scene);
-    return {true, std::move(output)};
-}
+        for (auto& thread : threads)
+            thread.join();
+    }
 
-void gll::free_model(model& mod)
-{
+    void run(worker_job& job)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (threads.size() < job.threads - 1)
+            threads.emplace_back([this]{ thread_main(); });
 
+        jobs.push_back(&job);
+        wake.notify_all();
+
+        job.running++;
+        execute(lock, job, 0);
+
+        while (job.next_id < job.threads)
+            execute(lock, job, claim(job));
+
+        finished.wait(lock, [&]{ return job.running == 0; });
+    }
+
+    //Runs task on a thread of its own, joined by the next launch after it is done or by the destructor
+    template<class F>
+    void launch(F task)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto it = background.begin(); it != background.end(); )
+        {
+            if (!*it->done)
+            {
+                ++it;
+                continue;
+            }
+            it->thread.join();
+            it = background.erase(it);
+        }
+
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        background.push_back({std::thread([task = std::move(task), done]() mutable {
+            task();
+            *done = true;
+        }), done});
+    }
+};
+
+//Runs worker(id) for every id below threads on the worker pool, id 0 runs on the calling thread
+template<class F>
+void run_workers(size_t threads, const F& worker)
+{
+    if (threads <= 1)
+    {
+        worker(0);
+        return;
+    }
+
+    worker_job job;
+    job.invoke  = [](const void* worker, size_t id){ (*static_cast<const F*>(worker))(id); };
+    job.worker  = &worker;
+    job.threads = threads;
+
+    worker_pool::get().run(job);
+}
+
+template<class F>
+void parallel_for(size_t count, size_t worker_threads, const F& fn)
+{
+    const size_t threads = resolve_worker_threads(worker_threads, count);
+
+    if (threads == 1)
+    {
+        for (size_t i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    std::unique_ptr<parallel_for_range[]> ranges(new parallel_for_range[threads]);
+    for (size_t t = 0; t < threads; t++)
+    {
+        ranges[t].next = count * t / threads;
+        ranges[t].end  = count * (t + 1) / threads;
+    }
+
+    run_workers(threads, [&](size_t id){
+        for (size_t k = 0; k < threads; k++)
+        {
+            auto& range = ranges[(id + k) % threads];
+            for (size_t i = range.next++; i < range.end; i = range.next++)
+                fn(i);
+        }
+    });
+}
+
+//Read only memory mappings of whole files
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+struct mapped_file
+{
+    const void* data = nullptr;
+    size_t      size = 0;
+};
+
+//A copy on write mapping can be written to without affecting the file
+bool map_file(const char* filepath, mapped_file& output, bool copy_on_write = false)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        mapping = CreateFileMappingA(file, nullptr, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+
+    const void* data = MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data)
+        return false;
+
+    output.data = data;
+    output.size = (size_t)size.QuadPart;
+    return true;
+#else
+    int file = open(filepath, O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat info;
+    void* data = MAP_FAILED;
+
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        data = mmap(nullptr, info.st_size, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, file, 0);
+
+    close(file);
+    if (data == MAP_FAILED)
+        return false;
+
+    output.data = data;
+    output.size = (size_t)info.st_size;
+    return true;
+#endif
+}
+
+void unmap_file(mapped_file& file)
+{
+    if (!file.data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file.data);
+#else
+    munmap(const_cast<void*>(file.data), file.size);
+#endif
+
+    file = {};
+}
+
+//Cooked file cache
+//Cooked files hold loader output in its final form, keyed by the source file and the load settings.
+//Blobs are 64 byte aligned within the file, so a mapping of it can hand them out in place.
+
+uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+template<class T>
+uint64_t hash_value(uint64_t hash, const T& value)
+{
+    return hash_bytes(hash, &value, sizeof(T));
+}
+
+//Identifies a source file by its absolute path, modification time and size; 0 if it cannot be inspected
+uint64_t hash_source_file(uint64_t hash, const char* filepath)
+{
+    std::error_code error;
+
+    const std::string path = std::filesystem::absolute(filepath, error).string();
+    if (error)
+        return 0;
+
+    const auto time = std::filesystem::last_write_time(filepath, error).time_since_epoch().count();
+    if (error)
+        return 0;
+
+    const auto size = std::filesystem::file_size(filepath, error);
+    if (error)
+        return 0;
+
+    hash = hash_bytes(hash, path.data(), path.size());
+    hash = hash_value(hash, time);
+    hash = hash_value(hash, size);
+    return hash;
+}
+
+std::string cooked_file_path(const std::string& directory, uint64_t key, const char* extension)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+    return (std::filesystem::path(directory) / (std::string(name) + extension)).string();
+}
+
+struct byte_writer
+{
+    std::vector<uint8_t> bytes;
+
+    void write(const void* data, size_t size)
+    {
+        const uint8_t* begin = static_cast<const uint8_t*>(data);
+        bytes.insert(bytes.end(), begin, begin + size);
+    }
+
+    template<class T>
+    void write(const T& value) { write(&value, sizeof(T)); }
+
+    //Writes a size followed by the aligned blob
+    void write_blob(const void* data, size_t size)
+    {
+        write((uint64_t)size);
+        bytes.resize((bytes.size() + 63) & ~size_t(63));
+        write(data, size);
+    }
+};
+
+//Bounds checked reads from a mapped file, every read fails once one did
+struct byte_reader
+{
+    const uint8_t*  data;
+    size_t          size;
+    size_t          position = 0;
+    bool            failed = false;
+
+    const uint8_t* read(size_t count)
+    {
+        if (failed || count > size - position)
+        {
+            failed = true;
+            return nullptr;
+        }
+
+        position += count;
+        return data + position - count;
+    }
+
+    template<class T>
+    T read()
+    {
+        T value{};
+        if (const uint8_t* source = read(sizeof(T)))
+            std::memcpy(&value, source, sizeof(T));
+        return value;
+    }
+
+    //Returns the blob written by byte_writer::write_blob
+    const uint8_t* read_blob(size_t& blob_size)
+    {
+        blob_size = (size_t)read<uint64_t>();
+        const size_t aligned = (position + 63) & ~size_t(63);
+
+        if (failed || aligned > size)
+        {
+            failed = true;
+            return nullptr;
+        }
+
+        position = aligned;
+        return read(blob_size);
+    }
+
+    template<class T>
+    void read_vector(std::vector<T>& output)
+    {
+        size_t blob_size;
+        const uint8_t* blob = read_blob(blob_size);
+        if (failed || blob_size % sizeof(T))
+        {
+            failed = true;
+            return;
+        }
+
+        output.resize(blob_size / sizeof(T));
+        if (blob_size)
+            std::memcpy(output.data(), blob, blob_size);
+    }
+};
+
+//Writes next to the destination and renames, so readers never see a partial file
+void write_cooked_file(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    //Thread ids repeat across processes sharing the cache directory, process ids tell them apart
+#ifdef _WIN32
+    const unsigned long process = GetCurrentProcessId();
+#else
+    const unsigned long process = (unsigned long)getpid();
+#endif
+
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%lx.%zx.tmp", process, std::hash<std::thread::id>()(std::this_thread::get_id()));
+    const std::string temporary = path + suffix;
+
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file)
+        return;
+
+    const bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+
+    if (fclose(file) == 0 && written)
+        std::filesystem::rename(temporary, path, error);
+    else
+        error = std::make_error_code(std::errc::io_error);
+
+    if (error)
+        std::filesystem::remove(temporary, error);
+}
+
+#include "stb/stb_image.hpp"
+
+//Reads the file through stb callbacks to count the bytes and to stop reading once cancelled
+struct image_read_state
+{
+    FILE*           file;
+    load_progress*  progress;
+};
+
+int image_read_callback(void* user, char* data, int size)
+{
+    auto state = static_cast<image_read_state*>(user);
+    if (state->progress->cancel_requested)
+        return 0;
+
+    size_t read = fread(data, 1, size, state->file);
+    state->progress->bytes_read += read;
+    return (int)read;
+}
+
+void image_skip_callback(void* user, int n)
+{
+    auto state = static_cast<image_read_state*>(user);
+    fseek(state->file, n, SEEK_CUR);
+}
+
+int image_eof_callback(void* user)
+{
+    auto state = static_cast<image_read_state*>(user);
+    return feof(state->file) || state->progress->cancel_requested;
+}
+
+size_t image_component_size(image::component_type type)
+{
+    switch (type)
+    {
+    case image::component_type::uint8:     return 1;
+    case image::component_type::uint16:    return 2;
+    case image::component_type::float32:   return 4;
+    }
+    return 0;
+}
+
+//stb loaders of the requested component type
+
+void* stbi_load_typed(const char* filepath, int* x, int* y, int* channels, int desired_channels, image::component_type type)
+{
+    switch (type)
+    {
+    case image::component_type::uint16:    return stbi_load_16(filepath, x, y, channels, desired_channels);
+    case image::component_type::float32:   return stbi_loadf(filepath, x, y, channels, desired_channels);
+    default:                                return stbi_load(filepath, x, y, channels, desired_channels);
+    }
+}
+
+void* stbi_load_typed_from_memory(const stbi_uc* data, int size, int* x, int* y, int* channels, int desired_channels, image::component_type type)
+{
+    switch (type)
+    {
+    case image::component_type::uint16:    return stbi_load_16_from_memory(data, size, x, y, channels, desired_channels);
+    case image::component_type::float32:   return stbi_loadf_from_memory(data, size, x, y, channels, desired_channels);
+    default:                                return stbi_load_from_memory(data, size, x, y, channels, desired_channels);
+    }
+}
+
+void* stbi_load_typed_from_callbacks(const stbi_io_callbacks* callbacks, void* user, int* x, int* y, int* channels, int desired_channels, image::component_type type)
+{
+    switch (type)
+    {
+    case image::component_type::uint16:    return stbi_load_16_from_callbacks(callbacks, user, x, y, channels, desired_channels);
+    case image::component_type::float32:   return stbi_loadf_from_callbacks(callbacks, user, x, y, channels, desired_channels);
+    default:                                return stbi_load_from_callbacks(callbacks, user, x, y, channels, desired_channels);
+    }
+}
+
+//Decodes either the file at filepath or, when it is null, the memory block
+result<image> decode_image(
+    const char*                 filepath,
+    const void*                 memory,
+    size_t                      memory_size,
+    const image_load_settings&  settings,
+    load_progress*              progress
+)
+{
+    if (settings.channels > 4)
+        return {false, {}};
+
+    stbi_set_flip_vertically_on_load_thread(settings.flip_vertically);
+
+    image img;
+    int width = 0, height = 0, channels = 0;
+    void* data = nullptr;
+    mapped_file mapping;
+
+    if (filepath && settings.memory_map)
+    {
+        if (!map_file(filepath, mapping))
+            return {false, {}};
+
+        memory = mapping.data;
+        memory_size = mapping.size;
+    }
+
+    if (memory)
+    {
+        if (memory_size <= INT_MAX)
+            data = stbi_load_typed_from_memory(
+                static_cast<const stbi_uc*>(memory),
+                (int)memory_size,
+                &width,
+                &height,
+                &channels,
+                settings.channels,
+                settings.type
+            );
+
+        if (progress)
+            progress->bytes_read += memory_size;
+    }
+    else if (!progress)
+    {
+        data = stbi_load_typed(
+            filepath,
+            &width,
+            &height,
+            &channels,
+            settings.channels,
+            settings.type
+        );
+    }
+    else
+    {
+        image_read_state state{fopen(filepath, "rb"), progress};
+        if (!state.file)
+            return {false, {}};
+
+        stbi_io_callbacks callbacks{image_read_callback, image_skip_callback, image_eof_callback};
+        data = stbi_load_typed_from_callbacks(&callbacks, &state, &width, &height, &channels, settings.channels, settings.type);
+        fclose(state.file);
+    }
+
+    unmap_file(mapping);
+
+    if (data && progress && progress->cancel_requested)
+    {
+        stbi_image_free(data);
+        data = nullptr;
+    }
+
+    if (!data)
+        return {false, {}};
+
+    img.width = width;
+    img.height = height;
+    img.color_channels = settings.channels ? settings.channels : channels;
+    img.type = settings.type;
+
+    img.pixel_data = data;
+    img.pixel_data_size = img.width * img.height * img.color_channels * image_component_size(img.type);
+
+    return {true, std::move(img)};
+}
+
+//Cooked image cache
+//A cooked image holds a header followed by the decoded pixels, which are used in place in the mapping
+
+constexpr char      cooked_image_magic[8]   = {'G', 'L', 'L', 'I', 'M', 'A', 'G', 'E'};
+constexpr uint32_t  cooked_image_version    = 3;
+
+//Every setting that changes the loaded image has to be hashed here
+uint64_t hash_image_load_settings(uint64_t hash, const image_load_settings& settings)
+{
+    hash = hash_value(hash, settings.flip_vertically);
+    hash = hash_value(hash, settings.channels);
+    hash = hash_value(hash, settings.type);
+    hash = hash_value(hash, settings.build_mips);
+
+    if (settings.build_mips)
+    {
+        hash = hash_value(hash, settings.mips.filter);
+        hash = hash_value(hash, settings.mips.srgb);
+        hash = hash_value(hash, settings.mips.levels);
+    }
+    return hash;
+}
+
+void write_cooked_image(const std::string& path, uint64_t key, const image& img)
+{
+    byte_writer writer;
+    writer.write(cooked_image_magic, sizeof(cooked_image_magic));
+    writer.write(cooked_image_version);
+    writer.write(key);
+
+    writer.write((uint64_t)img.width);
+    writer.write((uint64_t)img.height);
+    writer.write(img.color_channels);
+    writer.write(img.type);
+    writer.write_blob(img.mips.data(), img.mips.size() * sizeof(image::mip_level));
+    writer.write_blob(img.pixel_data, img.pixel_data_size);
+
+    write_cooked_file(path, writer.bytes);
+}
+
+result<image> read_cooked_image(const std::string& path, uint64_t key)
+{
+    mapped_file file;
+    if (!map_file(path.c_str(), file, true))
+        return {false, {}};
+
+    image img;
+    byte_reader reader{static_cast<const uint8_t*>(file.data), file.size};
+
+    const uint8_t* magic = reader.read(sizeof(cooked_image_magic));
+    const bool valid = magic
+        && std::memcmp(magic, cooked_image_magic, sizeof(cooked_image_magic)) == 0
+        && reader.read<uint32_t>() == cooked_image_version
+        && reader.read<uint64_t>() == key;
+
+    img.width = valid ? (size_t)reader.read<uint64_t>() : 0;
+    img.height = valid ? (size_t)reader.read<uint64_t>() : 0;
+    img.color_channels = valid ? reader.read<uint8_t>() : 0;
+    img.type = valid ? reader.read<image::component_type>() : image::component_type::uint8;
+
+    if (valid)
+        reader.read_vector(img.mips);
+
+    const uint8_t* pixels = valid ? reader.read_blob(img.pixel_data_size) : nullptr;
+
+    const size_t level_0_size = img.width * img.height * img.color_channels * image_component_size(img.type);
+    const size_t chain_size = img.mips.empty() ? level_0_size : img.mips.back().offset + img.mips.back().size;
+
+    if (!pixels || reader.failed || img.pixel_data_size != chain_size)
+    {
+        unmap_file(file);
+        return {false, {}};
+    }
+
+    img.pixel_data = const_cast<uint8_t*>(pixels);
+    img.mapping = const_cast<void*>(file.data);
+    img.mapping_size = file.size;
+
+    return {true, std::move(img)};
+}
+
+result<image> load_image_reporting(
+    const char*                 filepath,
+    const void*                 memory,
+    size_t                      memory_size,
+    const image_load_settings&  settings,
+    load_progress*              progress
+)
+{
+    uint64_t key = 0;
+
+    if (filepath && !settings.cache_directory.empty())
+    {
+        key = hash_value(14695981039346656037ull, cooked_image_version);
+        key = hash_image_load_settings(key, settings);
+        key = hash_source_file(key, filepath);
+    }
+
+    const std::string cooked_path = key ? cooked_file_path(settings.cache_directory, key, ".gllimage") : std::string();
+
+    if (key)
+    {
+        auto cooked = read_cooked_image(cooked_path, key);
+
+        if (cooked.first && progress)
+            progress->bytes_read += cooked.second.mapping_size;
+
+        if (cooked.first)
+            return cooked;
+    }
+
+    auto output = decode_image(filepath, memory, memory_size, settings, progress);
+
+    if (output.first && settings.build_mips)
+        generate_mips(output.second, settings.mips);
+
+    if (key && output.first)
+        write_cooked_image(cooked_path, key, output.second);
+
+    return output;
+}
+
+result<image> gll::load_image(const char* filepath, const image_load_settings& settings)
+{
+    return load_image_reporting(filepath, nullptr, 0, settings, nullptr);
+}
+
+result<image> gll::load_image(const void* data, size_t size, const image_load_settings& settings)
+{
+    return load_image_reporting(nullptr, data, size, settings, nullptr);
+}
+
+//Size of the decoded pixels, read from the file header without decoding
+size_t estimate_image_size(const char* filepath, const image_load_settings& settings)
+{
+    int width, height, channels;
+
+    if (!stbi_info(filepath, &width, &height, &channels))
+        return 0;
+
+    if (settings.channels)
+        channels = settings.channels;
+
+    return (size_t)width * height * channels * image_component_size(settings.type);
+}
+
+std::vector<result<image>> gll::load_images(const std::vector<const char*>& filepaths, const image_load_settings& settings)
+{
+    std::vector<result<image>> output(filepaths.size());
+
+    load_images(filepaths, settings, [&](size_t i, result<image>& img){
+        output[i] = std::move(img);
+    });
+
+    return output;
+}
+
+void gll::load_images(
+    const std::vector<const char*>&                         filepaths,
+    const image_load_settings&                              settings,
+    const std::function<void(size_t, result<image>&)>&      on_loaded
+)
+{
+    //Images are picked in input order, so the next image to deliver is always either decoded or being
+    //decoded. It is exempt from the bytes cap, which guarantees progress.
+
+    const size_t count = filepaths.size();
+    const size_t threads = resolve_worker_threads(settings.worker_threads, count);
+
+    std::mutex mutex;
+    std::condition_variable bytes_freed;
+
+    std::atomic<size_t>         next_image{0};
+    size_t                      next_delivery = 0;
+    size_t                      inflight_bytes = 0;
+    bool                        delivering = false;
+
+    std::vector<result<image>>  decoded(count);
+    std::vector<size_t>         decoded_bytes(count);
+    std::vector<bool>           done(count, false);
+
+    run_workers(threads, [&](size_t){
+        for (size_t i = next_image++; i < count; i = next_image++)
+        {
+            const size_t bytes = estimate_image_size(filepaths[i], settings);
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                bytes_freed.wait(lock, [&]{
+                    return settings.max_inflight_bytes == 0
+                        || i == next_delivery
+                        || inflight_bytes + bytes <= settings.max_inflight_bytes;
+                });
+                inflight_bytes += bytes;
+            }
+
+            auto img = load_image(filepaths[i], settings);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            decoded[i] = std::move(img);
+            decoded_bytes[i] = bytes;
+            done[i] = true;
+
+            //Only one thread hands the images over, the others just leave theirs behind
+            if (delivering)
+                continue;
+
+            delivering = true;
+            while (next_delivery < count && done[next_delivery])
+            {
+                const size_t d = next_delivery++;
+                auto item = std::move(decoded[d]);
+
+                lock.unlock();
+                on_loaded(d, item);
+                lock.lock();
+
+                inflight_bytes -= decoded_bytes[d];
+                bytes_freed.notify_all();
+            }
+            delivering = false;
+        }
+    });
+}
+
+//Mip chains
+//Every level is filtered from the previous one in linear float space and then stored in the image type.
+//Filters are separable: the vertical pass blends whole rows with SIMD, the horizontal pass blends pixels.
+
+//sRGB to linear for every 8 bit value
+const float* srgb_decode_table()
+{
+    static const std::array<float, 256> table = []{
+        std::array<float, 256> output;
+        for (size_t i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            output[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return output;
+    }();
+    return table.data();
+}
+
+//Linear, quantized to 16 bits, to 8 bit sRGB
+const uint8_t* srgb_encode_table()
+{
+    static const auto table = []{
+        std::array<uint8_t, 65536> output;
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            float c = i / 65535.0f;
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            output[i] = (uint8_t)(c * 255.0f + 0.5f);
+        }
+        return output;
+    }();
+    return table.data();
+}
+
+//Alpha of 2 and 4 channel images is never gamma encoded
+bool is_srgb_channel(size_t channel, size_t channels, const mip_settings& settings)
+{
+    return settings.srgb && !(channels % 2 == 0 && channel == channels - 1);
+}
+
+void decode_mip_level(const void* source, float* target, size_t count, size_t channels, image::component_type type, const mip_settings& settings)
+{
+    switch (type)
+    {
+    case image::component_type::uint8:
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(source);
+        const float* table = srgb_decode_table();
+        for (size_t i = 0; i < count; i++)
+            target[i] = is_srgb_channel(i % channels, channels, settings) ? table[src[i]] : src[i] / 255.0f;
+        return;
+    }
+    case image::component_type::uint16:
+    {
+        const uint16_t* src = static_cast<const uint16_t*>(source);
+        for (size_t i = 0; i < count; i++)
+            target[i] = src[i] / 65535.0f;
+        return;
+    }
+    case image::component_type::float32:
+        std::memcpy(target, source, count * sizeof(float));
+        return;
+    }
+}
+
+void encode_mip_level(const float* source, void* target, size_t count, size_t channels, image::component_type type, const mip_settings& settings)
+{
+    auto unorm = [](float value, float max){
+        return value <= 0 ? 0.0f : value >= 1 ? max : value * max + 0.5f;
+    };
+
+    switch (type)
+    {
+    case image::component_type::uint8:
+    {
+        uint8_t* dst = static_cast<uint8_t*>(target);
+        const uint8_t* table = srgb_encode_table();
+        for (size_t i = 0; i < count; i++)
+            dst[i] = is_srgb_channel(i % channels, channels, settings)
+                ? table[(size_t)unorm(source[i], 65535.0f)]
+                : (uint8_t)unorm(source[i], 255.0f);
+        return;
+    }
+    case image::component_type::uint16:
+    {
+        uint16_t* dst = static_cast<uint16_t*>(target);
+        for (size_t i = 0; i < count; i++)
+            dst[i] = (uint16_t)unorm(source[i], 65535.0f);
+        return;
+    }
+    case image::component_type::float32:
+        std::memcpy(target, source, count * sizeof(float));
+        return;
+    }
+}
+
+//Taps of every output pixel of a reduction to half the size, rounded down
+struct mip_filter_taps
+{
+    std::vector<size_t> first;      //source index of the first tap of every output pixel
+    std::vector<float>  weights;    //taps_count weights of every output pixel
+    size_t              taps_count;
+};
+
+float bessel_i0(float x)
+{
+    float sum = 1, term = 1;
+    for (int k = 1; k < 16; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+//Kaiser weight at distance d from the output pixel center, in half output pixels
+float mip_filter_weight(float d)
+{
+    constexpr float pi = 3.14159265358979f;
+    constexpr float radius = 3, beta = 4;
+
+    if (std::abs(d) >= radius)
+        return 0;
+
+    const float x = d / 2;
+    const float sinc = x == 0 ? 1.0f : std::sin(pi * x) / (pi * x);
+    const float ratio = d / radius;
+
+    return sinc * bessel_i0(beta * std::sqrt(1 - ratio * ratio)) / bessel_i0(beta);
+}
+
+//Every output pixel covers scale = source_size / target_size source pixels, which is 2.5 or 3 for odd
+//sizes. The box filter weights source pixels by how much of them the output pixel covers, so odd sizes
+//take 3 taps and blend the edge pixels in. The Kaiser filter is stretched by the same scale.
+//Source indices beyond the edges are clamped to them, a source size of 1 is passed through.
+mip_filter_taps build_mip_filter_taps(mip_filter filter, size_t source_size, size_t target_size)
+{
+    const float scale = (float)source_size / target_size;
+    const float half = scale / 2;
+
+    mip_filter_taps output;
+    output.taps_count = source_size == 1 ? 1 : filter == mip_filter::box ? (size_t)std::ceil(scale) : 2 * (size_t)std::ceil(3 * half);
+    output.first.resize(target_size);
+    output.weights.resize(target_size * output.taps_count);
+
+    for (size_t i = 0; i < target_size; i++)
+    {
+        const float center = (i + 0.5f) * scale;
+        const long long first = (long long)std::floor(center - output.taps_count / 2.0f + 0.5f);
+
+        float* weights = &output.weights[i * output.taps_count];
+        float sum = 0;
+
+        for (size_t t = 0; t < output.taps_count; t++)
+        {
+            const float texel = (float)(first + (long long)t);
+
+            if (source_size == 1)
+                weights[t] = 1;
+            else if (filter == mip_filter::box)
+                weights[t] = std::max(0.0f, std::min(texel + 1, center + half) - std::max(texel, center - half));
+            else
+                weights[t] = mip_filter_weight((texel + 0.5f - center) / half);
+
+            sum += weights[t];
+        }
+
+        for (size_t t = 0; t < output.taps_count; t++)
+            weights[t] /= sum;
+
+        output.first[i] = (size_t)first;
+    }
+
+    return output;
+}
+
+size_t clamp_tap(long long index, size_t size)
+{
+    return index < 0 ? 0 : (size_t)index >= size ? size - 1 : (size_t)index;
+}
+
+//target[i] += weight * source[i] over a row of floats
+void accumulate_row(float* target, const float* source, float weight, size_t count)
+{
+    size_t i = 0;
+
+#if defined(GLL_AVX2)
+    const __m256 w8 = _mm256_set1_ps(weight);
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(target + i, _mm256_add_ps(_mm256_loadu_ps(target + i), _mm256_mul_ps(w8, _mm256_loadu_ps(source + i))));
+#endif
+#if defined(GLL_SSE2)
+    const __m128 w4 = _mm_set1_ps(weight);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(target + i, _mm_add_ps(_mm_loadu_ps(target + i), _mm_mul_ps(w4, _mm_loadu_ps(source + i))));
+#endif
+
+    for (; i < count; i++)
+        target[i] += weight * source[i];
+}
+
+//Reduces a linear float level to the next one
+void filter_mip_level(
+    const std::vector<float>&   source,
+    size_t                      width,
+    size_t                      height,
+    std::vector<float>&         target,
+    size_t                      target_width,
+    size_t                      target_height,
+    size_t                      channels,
+    mip_filter                  filter
+)
+{
+    const mip_filter_taps vertical = build_mip_filter_taps(filter, height, target_height);
+    const mip_filter_taps horizontal = build_mip_filter_taps(filter, width, target_width);
+
+    const size_t row = width * channels;
+    std::vector<float> column_pass(row * target_height, 0.0f);
+
+    for (size_t y = 0; y < target_height; y++)
+        for (size_t t = 0; t < vertical.taps_count; t++)
+        {
+            const size_t source_y = clamp_tap((long long)vertical.first[y] + (long long)t, height);
+            accumulate_row(&column_pass[y * row], &source[source_y * row], vertical.weights[y * vertical.taps_count + t], row);
+        }
+
+    target.assign(target_width * target_height * channels, 0.0f);
+
+    for (size_t y = 0; y < target_height; y++)
+        for (size_t x = 0; x < target_width; x++)
+        {
+            float* dst = &target[(y * target_width + x) * channels];
+
+            for (size_t t = 0; t < horizontal.taps_count; t++)
+            {
+                const size_t source_x = clamp_tap((long long)horizontal.first[x] + (long long)t, width);
+                const float* src = &column_pass[y * row + source_x * channels];
+                const float weight = horizontal.weights[x * horizontal.taps_count + t];
+
+                for (size_t c = 0; c < channels; c++)
+                    dst[c] += weight * src[c];
+            }
+        }
+}
+
+//Gives back the pixels of an image, however they are owned
+void release_image_pixels(image& img)
+{
+    if (img.mapping)
+    {
+        mapped_file file{img.mapping, img.mapping_size};
+        unmap_file(file);
+    }
+    else if (img.allocated)
+        ::operator delete(img.pixel_data, std::align_val_t(image::storage_alignment));
+    else
+        stbi_image_free(img.pixel_data);
+
+    img.pixel_data = nullptr;
+    img.mapping = nullptr;
+    img.mapping_size = 0;
+    img.allocated = false;
+}
+
+bool gll::generate_mips(image& img, const mip_settings& settings)
+{
+    if (!img.pixel_data || !img.width || !img.height || !img.color_channels)
+        return false;
+
+    const size_t channels = img.color_channels;
+    const size_t component_size = image_component_size(img.type);
+
+    //Layout
+
+    size_t levels_count = 1;
+    while ((img.width >> levels_count) || (img.height >> levels_count))
+        levels_count++;
+
+    if (settings.levels && settings.levels < levels_count)
+        levels_count = settings.levels;
+
+    std::vector<image::mip_level> levels;
+    size_t size = 0;
+
+    for (size_t l = 0; l < levels_count; l++)
+    {
+        const size_t width = std::max<size_t>(img.width >> l, 1);
+        const size_t height = std::max<size_t>(img.height >> l, 1);
+        const size_t level_size = width * height * channels * component_size;
+
+        levels.push_back({width, height, size, level_size});
+        size += level_size;
+    }
+
+    //Filter
+
+    void* storage = ::operator new(size, std::align_val_t(image::storage_alignment));
+    uint8_t* target = static_cast<uint8_t*>(storage);
+
+    std::memcpy(target, img.pixel_data, levels[0].size);
+
+    std::vector<float> source(levels[0].width * levels[0].height * channels), filtered;
+    decode_mip_level(target, source.data(), source.size(), channels, img.type, settings);
+
+    for (size_t l = 1; l < levels_count; l++)
+    {
+        const auto& previous = levels[l - 1];
+        const auto& level = levels[l];
+
+        filter_mip_level(source, previous.width, previous.height, filtered, level.width, level.height, channels, settings.filter);
+        encode_mip_level(filtered.data(), target + level.offset, filtered.size(), channels, img.type, settings);
+        std::swap(source, filtered);
+    }
+
+    release_image_pixels(img);
+
+    img.pixel_data = storage;
+    img.pixel_data_size = size;
+    img.allocated = true;
+    img.mips = std::move(levels);
+
+    return true;
+}
+
+void gll::free_image(image& img)
+{
+    release_image_pixels(img);
+    img.mips.clear();
+}
+
+//Streamed image decoding
+//PNG, TGA and BMP files are decoded row by row into their native samples, so only one band of rows is
+//in memory at a time. Bands are then converted to the requested channels and component type the same
+//way stb converts whole images. Other files, and variants not handled here, are decoded whole.
+
+struct file_reader
+{
+    FILE*   file;
+    bool    failed = false;
+
+    bool read(void* data, size_t size)
+    {
+        if (!failed && fread(data, 1, size, file) != size)
+            failed = true;
+        return !failed;
+    }
+
+    void skip(size_t size)
+    {
+        if (!failed && fseek(file, (long)size, SEEK_CUR) != 0)
+            failed = true;
+    }
+
+    void rewind()
+    {
+        failed = fseek(file, 0, SEEK_SET) != 0;
+    }
+
+    uint8_t byte()
+    {
+        uint8_t value = 0;
+        read(&value, 1);
+        return value;
+    }
+
+    uint32_t u16le() { uint32_t b0 = byte(); return b0 | (uint32_t)byte() << 8; }
+    uint32_t u32le() { uint32_t b0 = u16le(); return b0 | u16le() << 16; }
+    uint32_t u32be() { uint32_t b0 = (uint32_t)byte() << 24; b0 |= (uint32_t)byte() << 16; b0 |= (uint32_t)byte() << 8; return b0 | byte(); }
+};
+
+//Larger widths and heights are rejected as corrupt, the same limit stb applies
+constexpr uint32_t max_image_dimension = 1u << 24;
+
+//Rows of an image in the order the file stores them
+struct row_decoder
+{
+    size_t                          width = 0;
+    size_t                          height = 0;
+    size_t                          channels = 0;
+    size_t                          bits = 8;           //8 or 16 per sample, 16 bit samples are in host order
+    bool                            bottom_up = false;  //the first row is the bottom of the image
+    std::function<bool(uint8_t*)>   read_row;
+};
+
+//Inflate
+
+uint32_t reverse_bits(uint32_t value, int count)
+{
+    uint32_t output = 0;
+    for (int i = 0; i < count; i++)
+        output |= ((value >> i) & 1) << (count - 1 - i);
+    return output;
+}
+
+//Canonical Huffman table, codes up to 9 bits are looked up directly
+struct inflate_huffman
+{
+    uint16_t    fast[512];      //(length << 9) | symbol, 0 for longer codes
+    uint16_t    first_code[16];
+    uint16_t    first_symbol[16];
+    int         max_code[17];   //one past the last code of every length, shifted to 16 bits
+    uint8_t     size[288];
+    uint16_t    value[288];
+
+    bool build(const uint8_t* lengths, size_t count)
+    {
+        int sizes[16] = {};
+        int next_code[16] = {};
+
+        std::memset(fast, 0, sizeof(fast));
+        for (size_t i = 0; i < count; i++)
+            sizes[lengths[i]]++;
+        sizes[0] = 0;
+
+        int code = 0, symbol = 0;
+        for (int i = 1; i < 16; i++)
+        {
+            next_code[i] = code;
+            first_code[i] = (uint16_t)code;
+            first_symbol[i] = (uint16_t)symbol;
+
+            code += sizes[i];
+            if (sizes[i] && code - 1 >= (1 << i))
+                return false;
+
+            max_code[i] = code << (16 - i);
+            code <<= 1;
+            symbol += sizes[i];
+        }
+        max_code[16] = 0x10000;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const int length = lengths[i];
+            if (!length)
+                continue;
+
+            const int c = next_code[length] - first_code[length] + first_symbol[length];
+            size[c] = (uint8_t)length;
+            value[c] = (uint16_t)i;
+
+            if (length <= 9)
+                for (uint32_t j = reverse_bits(next_code[length], length); j < 512; j += 1 << length)
+                    fast[j] = (uint16_t)(length << 9 | i);
+
+            next_code[length]++;
+        }
+
+        return true;
+    }
+};
+
+//Pull based zlib decompression, output is produced as it is asked for
+struct inflate_stream
+{
+    std::function<int()>    next_byte;      //-1 at the end of the input
+
+    uint64_t                bits = 0;
+    int                     bits_count = 0;
+    int                     padding = 0;    //zero bytes read past the end of the input
+    bool                    failed = false;
+
+    bool                    header_read = false;
+    bool                    last_block = false;
+    bool                    huffman_block = false;
+    size_t                  stored_length = 0;
+    size_t                  copy_length = 0;
+    size_t                  copy_distance = 0;
+
+    inflate_huffman         literals;
+    inflate_huffman         distances;
+
+    std::vector<uint8_t>    window = std::vector<uint8_t>(32768);
+    uint64_t                position = 0;
+
+    void refill()
+    {
+        while (bits_count <= 56)
+        {
+            int b = next_byte();
+            if (b < 0)
+            {
+                b = 0;
+                if (++padding > 16)
+                    failed = true;
+            }
+
+            bits |= (uint64_t)b << bits_count;
+            bits_count += 8;
+        }
+    }
+
+    uint32_t get(int count)
+    {
+        if (bits_count < count)
+            refill();
+
+        const uint32_t value = (uint32_t)(bits & ((1ull << count) - 1));
+        bits >>= count;
+        bits_count -= count;
+        return value;
+    }
+
+    int decode(const inflate_huffman& table)
+    {
+        if (bits_count < 16)
+            refill();
+
+        if (const uint16_t entry = table.fast[bits & 511])
+        {
+            get(entry >> 9);
+            return entry & 511;
+        }
+
+        const int code = (int)reverse_bits((uint32_t)(bits & 0xffff), 16);
+        int length = 10;
+        while (code >= table.max_code[length])
+            length++;
+
+        if (length >= 16)
+            return -1;
+
+        const int index = (code >> (16 - length)) - table.first_code[length] + table.first_symbol[length];
+        if (index >= 288 || table.size[index] != length)
+            return -1;
+
+        get(length);
+        return table.value[index];
+    }
+
+    bool read_dynamic_tables()
+    {
+        static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+        const size_t literals_count = get(5) + 257;
+        const size_t distances_count = get(5) + 1;
+        const size_t code_lengths_count = get(4) + 4;
+
+        uint8_t code_lengths[19] = {};
+        for (size_t i = 0; i < code_lengths_count; i++)
+            code_lengths[order[i]] = (uint8_t)get(3);
+
+        inflate_huffman code_lengths_table;
+        if (!code_lengths_table.build(code_lengths, 19))
+            return false;
+
+        uint8_t lengths[288 + 32] = {};
+        size_t count = 0;
+
+        while (count < literals_count + distances_count)
+        {
+            const int symbol = decode(code_lengths_table);
+            if (symbol < 0 || failed)
+                return false;
+
+            size_t repeat = 1;
+            uint8_t value = (uint8_t)symbol;
+
+            if (symbol == 16)
+            {
+                if (count == 0)
+                    return false;
+                repeat = get(2) + 3;
+                value = lengths[count - 1];
+            }
+            else if (symbol == 17)  { repeat = get(3) + 3;  value = 0; }
+            else if (symbol == 18)  { repeat = get(7) + 11; value = 0; }
+
+            if (count + repeat > literals_count + distances_count)
+                return false;
+
+            std::memset(lengths + count, value, repeat);
+            count += repeat;
+        }
+
+        return literals.build(lengths, literals_count) && distances.build(lengths + literals_count, distances_count);
+    }
+
+    bool start_block()
+    {
+        last_block = get(1);
+
+        switch (get(2))
+        {
+        case 0:
+        {
+            get(bits_count % 8);
+            const uint32_t length = get(16);
+            if ((length ^ 0xffff) != get(16))
+                return false;
+            stored_length = length;
+            return true;
+        }
+        case 1:
+        {
+            uint8_t lengths[288 + 32];
+            std::memset(lengths, 8, 144);
+            std::memset(lengths + 144, 9, 112);
+            std::memset(lengths + 256, 7, 24);
+            std::memset(lengths + 280, 8, 8);
+            std::memset(lengths + 288, 5, 32);
+
+            huffman_block = literals.build(lengths, 288) && distances.build(lengths + 288, 32);
+            return huffman_block;
+        }
+        case 2:
+            huffman_block = read_dynamic_tables();
+            return huffman_block;
+        }
+
+        return false;
+    }
+
+    bool read(uint8_t* output, size_t size)
+    {
+        static const uint16_t length_base[29]   = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t  length_extra[29]  = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const uint8_t  distance_extra[30]= {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        if (!header_read)
+        {
+            const uint32_t cmf = get(8), flg = get(8);
+            if ((cmf * 256 + flg) % 31 || (cmf & 15) != 8 || (flg & 32))
+                return false;
+            header_read = true;
+        }
+
+        auto emit = [&](uint8_t value){
+            *output++ = value;
+            window[position++ & 32767] = value;
+            size--;
+        };
+
+        while (size && !failed)
+        {
+            if (copy_length)
+            {
+                emit(window[(position - copy_distance) & 32767]);
+                copy_length--;
+            }
+            else if (stored_length)
+            {
+                emit((uint8_t)get(8));
+                stored_length--;
+            }
+            else if (huffman_block)
+            {
+                int symbol = decode(literals);
+
+                if (symbol < 0)
+                    return false;
+                else if (symbol < 256)
+                    emit((uint8_t)symbol);
+                else if (symbol == 256)
+                    huffman_block = false;
+                else
+                {
+                    symbol -= 257;
+                    if (symbol >= 29)
+                        return false;
+                    copy_length = length_base[symbol] + get(length_extra[symbol]);
+
+                    const int distance = decode(distances);
+                    if (distance < 0 || distance >= 30)
+                        return false;
+                    copy_distance = distance_base[distance] + get(distance_extra[distance]);
+
+                    if (copy_distance > position)
+                        return false;
+                }
+            }
+            else if (last_block || !start_block())
+                return false;
+        }
+
+        return !failed;
+    }
+};
+
+//PNG, non interlaced
+
+bool open_png_rows(file_reader& reader, row_decoder& output)
+{
+    static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+    uint8_t header[8];
+    if (!reader.read(header, 8) || std::memcmp(header, signature, 8))
+        return false;
+
+    uint32_t width = 0, height = 0;
+    uint8_t depth = 0, color_type = 0, interlace = 0;
+    std::vector<uint8_t> palette;           //rgba
+    std::vector<uint16_t> color_key;        //transparent grey or rgb sample values
+    bool palette_alpha = false;
+    bool has_header = false;
+    uint32_t idat_length = 0;
+
+    while (true)
+    {
+        const uint32_t length = reader.u32be();
+        char type[4];
+        if (!reader.read(type, 4))
+            return false;
+
+        if (!std::memcmp(type, "IDAT", 4))
+        {
+            idat_length = length;
+            break;
+        }
+
+        if (!std::memcmp(type, "IEND", 4))
+            return false;
+
+        if (!std::memcmp(type, "IHDR", 4) && length == 13)
+        {
+            width = reader.u32be();
+            height = reader.u32be();
+            depth = reader.byte();
+            color_type = reader.byte();
+            reader.byte();
+            reader.byte();
+            interlace = reader.byte();
+            has_header = true;
+        }
+        else if (!std::memcmp(type, "PLTE", 4) && length % 3 == 0 && length <= 768)
+        {
+            palette.assign(length / 3 * 4, 255);
+            for (size_t i = 0; i < length / 3; i++)
+                reader.read(&palette[i * 4], 3);
+        }
+        else if (!std::memcmp(type, "tRNS", 4) && color_type == 3 && length <= palette.size() / 4)
+        {
+            for (size_t i = 0; i < length; i++)
+                palette[i * 4 + 3] = reader.byte();
+            palette_alpha = true;
+        }
+        else if (!std::memcmp(type, "tRNS", 4) && (color_type == 0 || color_type == 2) && length == (color_type ? 6u : 2u))
+        {
+            color_key.resize(length / 2);
+            for (auto& sample : color_key)
+                sample = (uint16_t)(reader.byte() << 8 | reader.byte());
+        }
+        else
+            reader.skip(length);
+
+        reader.skip(4);     //crc
+        if (reader.failed)
+            return false;
+    }
+
+    static const size_t color_channels[7] = {1, 0, 3, 1, 2, 0, 4};
+
+    if (!has_header || !width || !height || width > max_image_dimension || height > max_image_dimension
+        || interlace || color_type > 6 || !color_channels[color_type])
+        return false;
+
+    const bool depth_valid = color_type == 3 ? (depth <= 8 && !(depth & (depth - 1)))
+        : color_type == 0 ? (depth <= 16 && !(depth & (depth - 1)))
+        : (depth == 8 || depth == 16);
+
+    if (!depth_valid || (color_type == 3 && palette.empty()))
+        return false;
+
+    const size_t source_channels = color_channels[color_type];
+    const bool paletted = color_type == 3;
+    const bool keyed = !color_key.empty();
+
+    output.width = width;
+    output.height = height;
+    output.bits = depth == 16 ? 16 : 8;
+    output.channels = paletted ? (palette_alpha ? 4 : 3) : source_channels + (keyed ? 1 : 0);
+    output.bottom_up = false;
+
+    //Rows
+
+    struct png_state
+    {
+        inflate_stream          inflater;
+        uint32_t                idat_remaining;
+        bool                    idat_ended = false;
+        std::vector<uint8_t>    row;
+        std::vector<uint8_t>    previous;
+    };
+
+    auto state = std::make_shared<png_state>();
+    state->idat_remaining = idat_length;
+
+    const size_t row_bytes = (width * source_channels * depth + 7) / 8;
+    const size_t pixel_bytes = std::max<size_t>(source_channels * depth / 8, 1);
+    state->row.resize(row_bytes + 1);
+    state->previous.assign(row_bytes + 1, 0);
+
+    //IDAT chunks are consecutive, their data forms one zlib stream
+    png_state* s = state.get();
+    s->inflater.next_byte = [s, &reader]() -> int {
+        while (!s->idat_remaining)
+        {
+            if (s->idat_ended)
+                return -1;
+
+            reader.skip(4);
+            s->idat_remaining = reader.u32be();
+
+            char type[4];
+            if (!reader.read(type, 4) || std::memcmp(type, "IDAT", 4))
+            {
+                s->idat_ended = true;
+                return -1;
+            }
+        }
+
+        s->idat_remaining--;
+        const uint8_t value = reader.byte();
+        return reader.failed ? -1 : value;
+    };
+
+    output.read_row = [state, row_bytes, pixel_bytes, depth, width, source_channels, paletted, palette, palette_alpha, keyed, color_key](uint8_t* target) {
+        uint8_t* row = state->row.data() + 1;
+        const uint8_t* previous = state->previous.data() + 1;
+
+        if (!state->inflater.read(state->row.data(), row_bytes + 1))
+            return false;
+
+        switch (state->row[0])
+        {
+        case 0: break;
+        case 1: for (size_t i = pixel_bytes; i < row_bytes; i++) row[i] += row[i - pixel_bytes]; break;
+        case 2: for (size_t i = 0; i < row_bytes; i++) row[i] += previous[i]; break;
+        case 3:
+            for (size_t i = 0; i < row_bytes; i++)
+                row[i] += (uint8_t)(((i >= pixel_bytes ? row[i - pixel_bytes] : 0) + previous[i]) / 2);
+            break;
+        case 4:
+            for (size_t i = 0; i < row_bytes; i++)
+            {
+                const int a = i >= pixel_bytes ? row[i - pixel_bytes] : 0;
+                const int b = previous[i];
+                const int c = i >= pixel_bytes ? previous[i - pixel_bytes] : 0;
+                const int p = a + b - c;
+                const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                row[i] += (uint8_t)(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+            }
+            break;
+        default:
+            return false;
+        }
+
+        std::swap(state->row, state->previous);
+        row = state->previous.data() + 1;
+
+        //Expand to native samples
+
+        auto sample = [&](size_t i) -> uint32_t {
+            if (depth == 16) return (uint32_t)row[i * 2] << 8 | row[i * 2 + 1];
+            if (depth == 8)  return row[i];
+            return (row[i * depth / 8] >> (8 - depth - (i * depth) % 8)) & ((1u << depth) - 1);
+        };
+
+        uint16_t* target_16 = reinterpret_cast<uint16_t*>(target);
+        const uint32_t max = depth == 16 ? 65535 : 255;
+
+        for (size_t x = 0; x < width; x++)
+        {
+            if (paletted)
+            {
+                const size_t index = sample(x);
+                if (index * 4 >= palette.size())
+                    return false;
+
+                for (size_t c = 0; c < 3; c++)
+                    *target++ = palette[index * 4 + c];
+
+                if (palette_alpha)
+                    *target++ = palette[index * 4 + 3];
+                continue;
+            }
+
+            bool transparent = keyed;
+            uint32_t values[4];
+
+            for (size_t c = 0; c < source_channels; c++)
+            {
+                values[c] = sample(x * source_channels + c);
+                if (keyed)
+                    transparent &= values[c] == color_key[c];
+
+                //Low bit depth grey is scaled to the full 8 bits
+                if (depth < 8)
+                    values[c] = values[c] * 255 / ((1u << depth) - 1);
+            }
+
+            const size_t count = source_channels + (keyed ? 1 : 0);
+            if (keyed)
+                values[source_channels] = transparent ? 0 : max;
+
+            for (size_t c = 0; c < count; c++)
+            {
+                if (depth == 16)
+                    *target_16++ = (uint16_t)values[c];
+                else
+                    *target++ = (uint8_t)values[c];
+            }
+        }
+
+        return true;
+    };
+
+    return true;
+}
+
+//BMP, uncompressed 8 bit paletted and 24 bit
+
+bool open_bmp_rows(file_reader& reader, row_decoder& output)
+{
+    if (reader.byte() != 'B' || reader.byte() != 'M')
+        return false;
+
+    reader.skip(8);
+    const uint32_t pixels_offset = reader.u32le();
+    const uint32_t header_size = reader.u32le();
+
+    if (reader.failed || header_size < 40)
+        return false;
+
+    const int32_t width = (int32_t)reader.u32le();
+    const int32_t height = (int32_t)reader.u32le();
+    reader.u16le();
+    const uint32_t bits = reader.u16le();
+    const uint32_t compression = reader.u32le();
+    reader.skip(12);
+    uint32_t colors = reader.u32le();
+    reader.skip(header_size - 36);
+
+    if (reader.failed || width <= 0 || height == 0 || height == INT32_MIN || compression != 0 || (bits != 8 && bits != 24)
+        || (uint32_t)width > max_image_dimension || (uint32_t)std::abs(height) > max_image_dimension)
+        return false;
+
+    std::vector<uint8_t> palette;
+    if (bits == 8)
+    {
+        if (colors == 0 || colors > 256)
+            colors = 256;
+
+        palette.resize(colors * 4);
+        reader.read(palette.data(), palette.size());
+    }
+
+    const size_t position = 14 + header_size + palette.size();
+    if (reader.failed || pixels_offset < position)
+        return false;
+    reader.skip(pixels_offset - position);
+
+    output.width = width;
+    output.height = height < 0 ? -(int64_t)height : height;
+    output.channels = 3;
+    output.bits = 8;
+    output.bottom_up = height > 0;
+
+    //Rows are padded to 4 bytes
+    const size_t stride = (output.width * bits + 31) / 32 * 4;
+    auto row = std::make_shared<std::vector<uint8_t>>(stride);
+
+    output.read_row = [&reader, row, palette, bits, width = output.width](uint8_t* target) {
+        if (!reader.read(row->data(), row->size()))
+            return false;
+
+        const uint8_t* source = row->data();
+        for (size_t x = 0; x < width; x++, target += 3)
+        {
+            if (bits == 8 && source[x] * 4u >= palette.size())
+                return false;
+
+            const uint8_t* bgr = bits == 8 ? palette.data() + source[x] * 4 : source + x * 3;
+
+            target[0] = bgr[2];
+            target[1] = bgr[1];
+            target[2] = bgr[0];
+        }
+        return true;
+    };
+
+    return true;
+}
+
+//TGA, uncompressed and run length encoded 8 bit grey, 24 and 32 bit color
+
+bool open_tga_rows(file_reader& reader, row_decoder& output)
+{
+    const uint32_t id_length = reader.byte();
+    const uint32_t color_map_type = reader.byte();
+    const uint32_t image_type = reader.byte();
+    reader.u16le();
+    const uint32_t color_map_length = reader.u16le();
+    const uint32_t color_map_bits = reader.byte();
+    reader.skip(4);
+    const uint32_t width = reader.u16le();
+    const uint32_t height = reader.u16le();
+    const uint32_t bits = reader.byte();
+    const uint32_t descriptor = reader.byte();
+
+    const bool grey = image_type == 3 || image_type == 11;
+    const bool color = image_type == 2 || image_type == 10;
+    const bool rle = image_type >= 9;
+
+    if (reader.failed || !width || !height || width > max_image_dimension || height > max_image_dimension
+        || color_map_type > 1 || (descriptor & 0x10)
+        || !((grey && bits == 8) || (color && (bits == 24 || bits == 32))))
+        return false;
+
+    reader.skip(id_length + (color_map_type ? color_map_length * ((color_map_bits + 7) / 8) : 0));
+
+    output.width = width;
+    output.height = height;
+    output.channels = bits / 8;
+    output.bits = 8;
+    output.bottom_up = !(descriptor & 0x20);
+
+    //Packets may continue from one row to the next
+    struct tga_state
+    {
+        uint32_t    packet_left = 0;
+        bool        repeat      = false;
+        uint8_t     pixel[4];
+    };
+
+    auto state = std::make_shared<tga_state>();
+    const size_t channels = output.channels;
+
+    output.read_row = [&reader, state, rle, channels, width](uint8_t* target) {
+        for (size_t x = 0; x < width; x++, target += channels)
+        {
+            if (rle && !state->packet_left)
+            {
+                const uint8_t header = reader.byte();
+                state->packet_left = (header & 127) + 1;
+                state->repeat = header & 128;
+
+                if (state->repeat)
+                    reader.read(state->pixel, channels);
+            }
+
+            if (!rle || !state->repeat)
+                reader.read(state->pixel, channels);
+
+            if (rle)
+                state->packet_left--;
+
+            std::memcpy(target, state->pixel, channels);
+            if (channels >= 3)
+                std::swap(target[0], target[2]);
+        }
+
+        return !reader.failed;
+    };
+
+    return true;
+}
+
+//Bands
+
+//8 bit values gamma decoded to linear float, the way stb does it
+const float* linear_from_uint8_table()
+{
+    static const auto table = []{
+        std::array<float, 256> output;
+        for (size_t i = 0; i < 256; i++)
+            output[i] = std::pow(i / 255.0f, 2.2f);
+        return output;
+    }();
+    return table.data();
+}
+
+//Converts a row of native samples to the requested channels and type, matching stb's conversions
+void convert_image_row(
+    const uint8_t*          source,
+    const row_decoder&      rows,
+    void*                   target,
+    size_t                  channels,
+    image::component_type   type
+)
+{
+    const uint16_t* source_16 = reinterpret_cast<const uint16_t*>(source);
+    const uint32_t max = rows.bits == 16 ? 65535 : 255;
+    const float* linear = linear_from_uint8_table();
+    const bool has_alpha = channels % 2 == 0;
+
+    for (size_t x = 0; x < rows.width; x++)
+    {
+        uint32_t s[4] = {};
+        for (size_t c = 0; c < rows.channels; c++)
+            s[c] = rows.bits == 16 ? *source_16++ : *source++;
+
+        const bool grey = rows.channels < 3;
+        const uint32_t r = s[0], g = grey ? s[0] : s[1], b = grey ? s[0] : s[2];
+        const uint32_t a = rows.channels == 2 ? s[1] : rows.channels == 4 ? s[3] : max;
+        const uint32_t luminance = grey ? s[0] : (r * 77 + g * 150 + b * 29) >> 8;
+
+        uint32_t values[4];
+        switch (channels)
+        {
+        case 1: values[0] = luminance; break;
+        case 2: values[0] = luminance; values[1] = a; break;
+        case 3: values[0] = r; values[1] = g; values[2] = b; break;
+        default: values[0] = r; values[1] = g; values[2] = b; values[3] = a; break;
+        }
+
+        for (size_t c = 0; c < channels; c++)
+        {
+            const uint32_t value = values[c];
+            const uint32_t value_8 = rows.bits == 16 ? value >> 8 : value;
+
+            switch (type)
+            {
+            case image::component_type::uint8:
+                *static_cast<uint8_t*>(target) = (uint8_t)value_8;
+                target = static_cast<uint8_t*>(target) + 1;
+                break;
+            case image::component_type::uint16:
+                *static_cast<uint16_t*>(target) = (uint16_t)(rows.bits == 16 ? value : value * 257);
+                target = static_cast<uint16_t*>(target) + 1;
+                break;
+            case image::component_type::float32:
+                *static_cast<float*>(target) = has_alpha && c == channels - 1 ? value_8 / 255.0f : linear[value_8];
+                target = static_cast<float*>(target) + 1;
+                break;
+            }
+        }
+    }
+}
+
+//Opens the file with the decoder matching its header, tga files are recognized by their extension
+bool open_image_rows(file_reader& reader, const char* filepath, row_decoder& output)
+{
+    if (open_png_rows(reader, output))
+        return true;
+
+    reader.rewind();
+    if (open_bmp_rows(reader, output))
+        return true;
+
+    std::string extension = std::filesystem::path(filepath).extension().string();
+    for (auto& c : extension)
+        c = (char)std::tolower((unsigned char)c);
+
+    reader.rewind();
+    return extension == ".tga" && open_tga_rows(reader, output);
+}
+
+bool gll::load_image_streamed(
+    const char*                                     filepath,
+    const image_load_settings&                      settings,
+    size_t                                          band_rows,
+    const std::function<bool(const image_band&)>&   on_band
+)
+{
+    if (settings.channels > 4 || !band_rows)
+        return false;
+
+    //Closed on every way out, the decoders and the callback may throw
+    std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(filepath, "rb"), fclose);
+    if (!file)
+        return false;
+
+    file_reader reader{file.get()};
+    row_decoder rows;
+
+    if (!open_image_rows(reader, filepath, rows))
+    {
+        file.reset();
+
+        image_load_settings whole = settings;
+        whole.build_mips = false;
+
+        auto img = decode_image(filepath, nullptr, 0, whole, nullptr);
+        if (!img.first)
+            return false;
+
+        const size_t row_size = img.second.width * img.second.color_channels * image_component_size(img.second.type);
+        bool completed = true;
+
+        for (size_t row = 0; row < img.second.height && completed; row += band_rows)
+        {
+            image_band band;
+            band.width = img.second.width;
+            band.height = img.second.height;
+            band.color_channels = img.second.color_channels;
+            band.type = img.second.type;
+            band.first_row = row;
+            band.rows = std::min(band_rows, img.second.height - row);
+            band.pixels = static_cast<const uint8_t*>(img.second.pixel_data) + row * row_size;
+
+            completed = on_band(band);
+        }
+
+        free_image(img.second);
+        return completed;
+    }
+
+    const size_t channels = settings.channels ? settings.channels : rows.channels;
+    const size_t row_size = rows.width * channels * image_component_size(settings.type);
+
+    std::vector<uint8_t> native(rows.width * rows.channels * rows.bits / 8);
+    std::vector<uint8_t> converted(std::min(band_rows, rows.height) * row_size);
+
+    //Output rows run opposite to the file rows when exactly one of the file and the settings flips them
+    const bool descending = rows.bottom_up != settings.flip_vertically;
+    bool completed = true;
+
+    for (size_t row = 0; row < rows.height && completed; row += band_rows)
+    {
+        const size_t count = std::min(band_rows, rows.height - row);
+
+        for (size_t i = 0; i < count && completed; i++)
+        {
+            completed = rows.read_row(native.data());
+            if (completed)
+                convert_image_row(native.data(), rows, converted.data() + (descending ? count - 1 - i : i) * row_size, channels, settings.type);
+        }
+
+        if (!completed)
+            break;
+
+        image_band band;
+        band.width = rows.width;
+        band.height = rows.height;
+        band.color_channels = (uint8_t)channels;
+        band.type = settings.type;
+        band.first_row = descending ? rows.height - row - count : row;
+        band.rows = count;
+        band.pixels = converted.data();
+
+        completed = on_band(band);
+    }
+
+    return completed;
+}
+
+//Block compression
+//Every 4x4 block is gathered into floats and encoded on its own. Endpoints come from the bounding box
+//(fast) or the principal axis of the block (normal, high); high also refits them to the chosen indices
+//by least squares. Indices are found by projecting the pixels onto the endpoint line, four at a time
+//with SSE2, except for high quality BC7, which searches the whole palette.
+
+struct block_pixels
+{
+    alignas(16) float channels[4][16];  //r, g, b, a of the pixels in row major order
+};
+
+//Edge blocks repeat the last row and column. With raw set the first two channels are taken as
+//stored, otherwise grey and grey alpha images are expanded to rgba.
+void gather_block(
+    block_pixels&   output,
+    const uint8_t*  pixels,
+    size_t          width,
+    size_t          height,
+    size_t          channels,
+    size_t          block_x,
+    size_t          block_y,
+    bool            raw
+)
+{
+    for (size_t y = 0; y < 4; y++)
+        for (size_t x = 0; x < 4; x++)
+        {
+            const size_t px = std::min(block_x * 4 + x, width - 1);
+            const size_t py = std::min(block_y * 4 + y, height - 1);
+            const uint8_t* src = pixels + (py * width + px) * channels;
+            const size_t i = y * 4 + x;
+
+            const float grey = src[0];
+            float rgba[4] = {grey, grey, grey, 255};
+
+            if (raw)
+                rgba[1] = channels > 1 ? src[1] : src[0];
+            else if (channels == 2)
+                rgba[3] = src[1];
+            else if (channels >= 3)
+            {
+                rgba[1] = src[1];
+                rgba[2] = src[2];
+                if (channels == 4)
+                    rgba[3] = src[3];
+            }
+
+            for (size_t c = 0; c < 4; c++)
+                output.channels[c][i] = rgba[c];
+        }
+}
+
+//Quantizes the position of every pixel along the line from e0 to e1 into steps + 1 levels
+void project_block_indices(const block_pixels& block, const float* e0, const float* e1, size_t channels, int steps, uint8_t* output)
+{
+    float direction[4] = {0, 0, 0, 0};
+    float length = 0;
+
+    for (size_t c = 0; c < channels; c++)
+    {
+        direction[c] = e1[c] - e0[c];
+        length += direction[c] * direction[c];
+    }
+
+    if (length <= 0)
+    {
+        std::memset(output, 0, 16);
+        return;
+    }
+
+    const float scale = steps / length;
+    size_t i = 0;
+
+#if defined(GLL_SSE2)
+    for (; i < 16; i += 4)
+    {
+        __m128 t = _mm_setzero_ps();
+        for (size_t c = 0; c < channels; c++)
+        {
+            __m128 offset = _mm_sub_ps(_mm_load_ps(block.channels[c] + i), _mm_set1_ps(e0[c]));
+            t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(direction[c])));
+        }
+
+        t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(t, _mm_set1_ps(scale)), _mm_setzero_ps()), _mm_set1_ps((float)steps));
+
+        alignas(16) int32_t levels[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(levels), _mm_cvttps_epi32(_mm_add_ps(t, _mm_set1_ps(0.5f))));
+
+        for (size_t k = 0; k < 4; k++)
+            output[i + k] = (uint8_t)levels[k];
+    }
+#endif
+
+    for (; i < 16; i++)
+    {
+        float t = 0;
+        for (size_t c = 0; c < channels; c++)
+            t += (block.channels[c][i] - e0[c]) * direction[c];
+
+        t = std::min(std::max(t * scale, 0.0f), (float)steps);
+        output[i] = (uint8_t)(t + 0.5f);
+    }
+}
+
+void block_endpoints(const block_pixels& block, size_t channels, bool principal_axis, float* e0, float* e1)
+{
+    float min[4], max[4], mean[4];
+
+    for (size_t c = 0; c < channels; c++)
+    {
+        min[c] = max[c] = block.channels[c][0];
+        mean[c] = 0;
+
+        for (size_t i = 0; i < 16; i++)
+        {
+            min[c] = std::min(min[c], block.channels[c][i]);
+            max[c] = std::max(max[c], block.channels[c][i]);
+            mean[c] += block.channels[c][i] / 16;
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (size_t i = 0; i < 16; i++)
+        for (size_t a = 0; a < channels; a++)
+            for (size_t b = 0; b < channels; b++)
+                covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+
+    //The bounding box diagonal, oriented along the channel with the widest range
+    size_t widest = 0;
+    for (size_t c = 1; c < channels; c++)
+        if (max[c] - min[c] > max[widest] - min[widest])
+            widest = c;
+
+    float axis[4] = {0, 0, 0, 0};
+    for (size_t c = 0; c < channels; c++)
+        axis[c] = covariance[widest][c] < 0 ? min[c] - max[c] : max[c] - min[c];
+
+    if (!principal_axis)
+    {
+        for (size_t c = 0; c < channels; c++)
+        {
+            e0[c] = axis[c] < 0 ? max[c] : min[c];
+            e1[c] = axis[c] < 0 ? min[c] : max[c];
+        }
+        return;
+    }
+
+    //Power iteration from the diagonal
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {0, 0, 0, 0};
+        float length = 0;
+
+        for (size_t a = 0; a < channels; a++)
+        {
+            for (size_t b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length = std::max(length, std::abs(next[a]));
+        }
+
+        if (length <= 0)
+            break;
+
+        for (size_t c = 0; c < channels; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float t_min = 0, t_max = 0, length = 0;
+    for (size_t c = 0; c < channels; c++)
+        length += axis[c] * axis[c];
+
+    if (length > 0)
+        for (size_t i = 0; i < 16; i++)
+        {
+            float t = 0;
+            for (size_t c = 0; c < channels; c++)
+                t += (block.channels[c][i] - mean[c]) * axis[c];
+
+            t_min = std::min(t_min, t / length);
+            t_max = std::max(t_max, t / length);
+        }
+
+    for (size_t c = 0; c < channels; c++)
+    {
+        e0[c] = std::min(std::max(mean[c] + axis[c] * t_min, 0.0f), 255.0f);
+        e1[c] = std::min(std::max(mean[c] + axis[c] * t_max, 0.0f), 255.0f);
+    }
+}
+
+//Least squares endpoints for the given interpolation weights of the pixels, 0 at e0 and 1 at e1
+void refit_block_endpoints(const block_pixels& block, size_t channels, const float* weights, float* e0, float* e1)
+{
+    float aa = 0, ab = 0, bb = 0;
+    float ax[4] = {}, bx[4] = {};
+
+    for (size_t i = 0; i < 16; i++)
+    {
+        const float a = 1 - weights[i], b = weights[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+
+        for (size_t c = 0; c < channels; c++)
+        {
+            ax[c] += a * block.channels[c][i];
+            bx[c] += b * block.channels[c][i];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+        return;
+
+    for (size_t c = 0; c < channels; c++)
+    {
+        e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+        e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+    }
+}
+
+//BC1
+
+uint16_t pack_rgb565(const float* color)
+{
+    auto quantize = [](float value, int max){ return (uint16_t)std::min(std::max((int)(value * max / 255.0f + 0.5f), 0), max); };
+    return (uint16_t)(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31));
+}
+
+void unpack_rgb565(uint16_t value, float* color)
+{
+    const int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+    color[0] = (float)(r << 3 | r >> 2);
+    color[1] = (float)(g << 2 | g >> 4);
+    color[2] = (float)(b << 3 | b >> 2);
+}
+
+//Squared error of the block encoded with the given endpoints and steps, 0 at c0 and steps at c1
+float block_line_error(const block_pixels& block, size_t channels, const float* c0, const float* c1, const uint8_t* levels, int steps)
+{
+    float error = 0;
+    for (size_t i = 0; i < 16; i++)
+        for (size_t c = 0; c < channels; c++)
+        {
+            const float w = (float)levels[i] / steps;
+            const float d = c0[c] + (c1[c] - c0[c]) * w - block.channels[c][i];
+            error += d * d;
+        }
+    return error;
+}
+
+//Color half of BC1 and BC3, always in the four color mode
+void encode_bc1_color(const block_pixels& block, compression_quality quality, uint8_t* output)
+{
+    float e0[4], e1[4];
+    block_endpoints(block, 3, quality != compression_quality::fast, e0, e1);
+
+    uint16_t c0, c1;
+    float q0[3], q1[3];
+    uint8_t levels[16];
+
+    auto quantize = [&](const float* a, const float* b, uint16_t& p0, uint16_t& p1, float* d0, float* d1, uint8_t* l){
+        p0 = pack_rgb565(a);
+        p1 = pack_rgb565(b);
+        unpack_rgb565(p0, d0);
+        unpack_rgb565(p1, d1);
+        project_block_indices(block, d0, d1, 3, 3, l);
+    };
+
+    quantize(e0, e1, c0, c1, q0, q1, levels);
+
+    if (quality == compression_quality::high)
+    {
+        float error = block_line_error(block, 3, q0, q1, levels, 3);
+
+        for (int iteration = 0; iteration < 2; iteration++)
+        {
+            float weights[16];
+            for (size_t i = 0; i < 16; i++)
+                weights[i] = levels[i] / 3.0f;
+
+            refit_block_endpoints(block, 3, weights, e0, e1);
+
+            uint16_t r0, r1;
+            float d0[3], d1[3];
+            uint8_t refit[16];
+            quantize(e0, e1, r0, r1, d0, d1, refit);
+
+            const float refit_error = block_line_error(block, 3, d0, d1, refit, 3);
+            if (refit_error >= error)
+                break;
+
+            error = refit_error;
+            c0 = r0; c1 = r1;
+            std::memcpy(levels, refit, 16);
+        }
+    }
+
+    //The four color mode needs c0 > c1, equal endpoints only use index 0
+    if (c0 < c1)
+    {
+        std::swap(c0, c1);
+        for (auto& level : levels)
+            level = 3 - level;
+    }
+
+    if (c0 == c1)
+        std::memset(levels, 0, 16);
+
+    static const uint8_t level_index[4] = {0, 2, 3, 1};
+    uint32_t indices = 0;
+    for (size_t i = 0; i < 16; i++)
+        indices |= (uint32_t)level_index[levels[i]] << (i * 2);
+
+    std::memcpy(output + 0, &c0, 2);
+    std::memcpy(output + 2, &c1, 2);
+    std::memcpy(output + 4, &indices, 4);
+}
+
+//BC4, the alpha half of BC3 and both halves of BC5
+
+void encode_bc4(const float* values, compression_quality quality, uint8_t* output)
+{
+    auto encode = [&](int a0, int a1, bool six_values, uint8_t* block) {
+        int palette[8] = {a0, a1};
+        if (!six_values)
+            for (int i = 2; i < 8; i++)
+                palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        else
+        {
+            for (int i = 2; i < 6; i++)
+                palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t bits = (uint64_t)a0 | (uint64_t)a1 << 8;
+        float error = 0;
+
+        for (size_t i = 0; i < 16; i++)
+        {
+            size_t best = 0;
+            float best_error = 1e30f;
+            for (size_t p = 0; p < 8; p++)
+            {
+                const float d = palette[p] - values[i];
+                if (d * d < best_error)
+                {
+                    best_error = d * d;
+                    best = p;
+                }
+            }
+
+            error += best_error;
+            bits |= (uint64_t)best << (16 + i * 3);
+        }
+
+        std::memcpy(block, &bits, 8);
+        return error;
+    };
+
+    int min = 255, max = 0, inner_min = 255, inner_max = 0;
+    for (size_t i = 0; i < 16; i++)
+    {
+        const int value = (int)(values[i] + 0.5f);
+        min = std::min(min, value);
+        max = std::max(max, value);
+
+        if (value != 0 && value != 255)
+        {
+            inner_min = std::min(inner_min, value);
+            inner_max = std::max(inner_max, value);
+        }
+    }
+
+    //a0 > a1 selects the eight value mode, a0 <= a1 the six value mode with exact 0 and 255
+    const float error = encode(max, min, max == min, output);
+
+    if (quality == compression_quality::high && inner_min <= inner_max)
+    {
+        uint8_t six_values[8];
+        if (encode(inner_min, inner_max, true, six_values) < error)
+            std::memcpy(output, six_values, 8);
+    }
+}
+
+//BC7, mode 6 only: one subset of rgba endpoints with 7 bits and a p-bit per endpoint, 4 bit indices
+
+static const int bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct bc7_candidate
+{
+    int         endpoints[2][4];    //7 bit
+    int         pbits[2];
+    uint8_t     indices[16];
+    float       error;
+};
+
+void evaluate_bc7_candidate(
+    bc7_candidate&          output,
+    const block_pixels&     block,
+    const float*            e0,
+    const float*            e1,
+    int                     p0,
+    int                     p1,
+    bool                    exhaustive
+)
+{
+    float decoded[2][4];
+    const float* endpoints[2] = {e0, e1};
+    const int pbits[2] = {p0, p1};
+
+    for (size_t e = 0; e < 2; e++)
+    {
+        output.pbits[e] = pbits[e];
+        for (size_t c = 0; c < 4; c++)
+        {
+            int value = (int)std::floor((endpoints[e][c] - pbits[e]) / 2 + 0.5f);
+            value = std::min(std::max(value, 0), 127);
+
+            output.endpoints[e][c] = value;
+            decoded[e][c] = (float)(value << 1 | pbits[e]);
+        }
+    }
+
+    float palette[16][4];
+    for (size_t i = 0; i < 16; i++)
+        for (size_t c = 0; c < 4; c++)
+            palette[i][c] = (float)(((64 - bc7_weights[i]) * (int)decoded[0][c] + bc7_weights[i] * (int)decoded[1][c] + 32) >> 6);
+
+    if (!exhaustive)
+        project_block_indices(block, decoded[0], decoded[1], 4, 15, output.indices);
+
+    output.error = 0;
+    for (size_t i = 0; i < 16; i++)
+    {
+        auto distance = [&](size_t p){
+            float error = 0;
+            for (size_t c = 0; c < 4; c++)
+            {
+                const float d = palette[p][c] - block.channels[c][i];
+                error += d * d;
+            }
+            return error;
+        };
+
+        if (exhaustive)
+        {
+            output.indices[i] = 0;
+            for (uint8_t p = 1; p < 16; p++)
+                if (distance(p) < distance(output.indices[i]))
+                    output.indices[i] = p;
+        }
+
+        output.error += distance(output.indices[i]);
+    }
+}
+
+//The p-bit of an endpoint that reproduces it best on its own
+int best_bc7_pbit(const float* endpoint)
+{
+    float error[2] = {0, 0};
+    for (int p = 0; p < 2; p++)
+        for (size_t c = 0; c < 4; c++)
+        {
+            int value = std::min(std::max((int)std::floor((endpoint[c] - p) / 2 + 0.5f), 0), 127);
+            error[p] += std::abs((float)(value << 1 | p) - endpoint[c]);
+        }
+    return error[1] < error[0] ? 1 : 0;
+}
+
+void encode_bc7(const block_pixels& block, compression_quality quality, uint8_t* output)
+{
+    float e0[4], e1[4];
+    block_endpoints(block, 4, quality != compression_quality::fast, e0, e1);
+
+    bc7_candidate best;
+
+    if (quality != compression_quality::high)
+        evaluate_bc7_candidate(best, block, e0, e1, best_bc7_pbit(e0), best_bc7_pbit(e1), false);
+    else
+    {
+        best.error = 1e30f;
+
+        for (int pass = 0; pass < 2; pass++)
+        {
+            if (pass == 1)
+            {
+                float weights[16];
+                for (size_t i = 0; i < 16; i++)
+                    weights[i] = bc7_weights[best.indices[i]] / 64.0f;
+                refit_block_endpoints(block, 4, weights, e0, e1);
+            }
+
+            for (int pbits = 0; pbits < 4; pbits++)
+            {
+                bc7_candidate candidate;
+                evaluate_bc7_candidate(candidate, block, e0, e1, pbits & 1, pbits >> 1, true);
+                if (candidate.error < best.error)
+                    best = candidate;
+            }
+        }
+    }
+
+    //The anchor index is stored without its top bit, so it has to be below 8
+    if (best.indices[0] >= 8)
+    {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        std::swap(best.pbits[0], best.pbits[1]);
+        for (auto& index : best.indices)
+            index = 15 - index;
+    }
+
+    uint64_t bits[2] = {0, 0};
+    size_t position = 0;
+
+    auto write = [&](uint64_t value, size_t count){
+        for (size_t b = 0; b < count; b++, position++)
+            bits[position / 64] |= ((value >> b) & 1) << (position % 64);
+    };
+
+    write(1 << 6, 7);
+    for (size_t c = 0; c < 4; c++)
+    {
+        write(best.endpoints[0][c], 7);
+        write(best.endpoints[1][c], 7);
+    }
+    write(best.pbits[0], 1);
+    write(best.pbits[1], 1);
+    for (size_t i = 0; i < 16; i++)
+        write(best.indices[i], i == 0 ? 3 : 4);
+
+    std::memcpy(output, bits, 16);
+}
+
+size_t block_format_size(block_format format)
+{
+    return format == block_format::bc1 ? 8 : 16;
+}
+
+void encode_block(const block_pixels& block, const compression_settings& settings, uint8_t* output)
+{
+    switch (settings.format)
+    {
+    case block_format::bc1:
+        return encode_bc1_color(block, settings.quality, output);
+    case block_format::bc3:
+        encode_bc4(block.channels[3], settings.quality, output);
+        return encode_bc1_color(block, settings.quality, output + 8);
+    case block_format::bc5:
+        encode_bc4(block.channels[0], settings.quality, output);
+        return encode_bc4(block.channels[1], settings.quality, output + 8);
+    case block_format::bc7:
+        return encode_bc7(block, settings.quality, output);
+    }
+}
+
+result<compressed_image> gll::compress_image(const image& img, const compression_settings& settings)
+{
+    if (!img.pixel_data || !img.width || !img.height || img.type != image::component_type::uint8)
+        return {false, {}};
+
+    if (!img.color_channels || img.color_channels > 4)
+        return {false, {}};
+
+    const std::vector<image::mip_level> levels = img.mips.empty()
+        ? std::vector<image::mip_level>{{img.width, img.height, 0, img.pixel_data_size}}
+        : img.mips;
+
+    compressed_image output;
+    output.format = settings.format;
+    output.width = img.width;
+    output.height = img.height;
+
+    //One job per row of blocks of every level
+
+    const size_t block_size = block_format_size(settings.format);
+    std::vector<std::pair<size_t, size_t>> jobs;
+    size_t size = 0;
+
+    for (size_t l = 0; l < levels.size(); l++)
+    {
+        const size_t blocks_x = (levels[l].width + 3) / 4;
+        const size_t blocks_y = (levels[l].height + 3) / 4;
+
+        output.mips.push_back({levels[l].width, levels[l].height, size, blocks_x * blocks_y * block_size});
+        size += output.mips.back().size;
+
+        for (size_t y = 0; y < blocks_y; y++)
+            jobs.push_back({l, y});
+    }
+
+    output.blocks.resize(size);
+
+    parallel_for(jobs.size(), settings.worker_threads, [&](size_t j){
+        const auto [l, y] = jobs[j];
+        const auto& level = levels[l];
+        const uint8_t* pixels = static_cast<const uint8_t*>(img.pixel_data) + level.offset;
+
+        const size_t blocks_x = (level.width + 3) / 4;
+        uint8_t* target = output.blocks.data() + output.mips[l].offset + y * blocks_x * block_size;
+
+        block_pixels block;
+        for (size_t x = 0; x < blocks_x; x++)
+        {
+            gather_block(block, pixels, level.width, level.height, img.color_channels, x, y, settings.format == block_format::bc5);
+            encode_block(block, settings, target + x * block_size);
+        }
+    });
+
+    return {true, std::move(output)};
+}
+
+//Cooked compressed images hold a header, the levels and the blocks
+
+constexpr char      cooked_blocks_magic[8]  = {'G', 'L', 'L', 'B', 'L', 'O', 'C', 'K'};
+constexpr uint32_t  cooked_blocks_version   = 1;
+
+uint64_t hash_compression_settings(uint64_t hash, const compression_settings& settings)
+{
+    hash = hash_value(hash, settings.format);
+    hash = hash_value(hash, settings.quality);
+    return hash;
+}
+
+void write_cooked_blocks(const std::string& path, uint64_t key, const compressed_image& img)
+{
+    byte_writer writer;
+    writer.write(cooked_blocks_magic, sizeof(cooked_blocks_magic));
+    writer.write(cooked_blocks_version);
+    writer.write(key);
+
+    writer.write(img.format);
+    writer.write((uint64_t)img.width);
+    writer.write((uint64_t)img.height);
+    writer.write_blob(img.mips.data(), img.mips.size() * sizeof(image::mip_level));
+    writer.write_blob(img.blocks.data(), img.blocks.size());
+
+    write_cooked_file(path, writer.bytes);
+}
+
+result<compressed_image> read_cooked_blocks(const std::string& path, uint64_t key)
+{
+    mapped_file file;
+    if (!map_file(path.c_str(), file))
+        return {false, {}};
+
+    compressed_image output;
+    byte_reader reader{static_cast<const uint8_t*>(file.data), file.size};
+
+    const uint8_t* magic = reader.read(sizeof(cooked_blocks_magic));
+    const bool valid = magic
+        && std::memcmp(magic, cooked_blocks_magic, sizeof(cooked_blocks_magic)) == 0
+        && reader.read<uint32_t>() == cooked_blocks_version
+        && reader.read<uint64_t>() == key;
+
+    if (valid)
+    {
+        output.format = reader.read<block_format>();
+        output.width = (size_t)reader.read<uint64_t>();
+        output.height = (size_t)reader.read<uint64_t>();
+        reader.read_vector(output.mips);
+        reader.read_vector(output.blocks);
+    }
+
+    unmap_file(file);
+
+    if (!valid || reader.failed || output.mips.empty() || output.mips.back().offset + output.mips.back().size != output.blocks.size())
+        return {false, {}};
+
+    return {true, std::move(output)};
+}
+
+result<compressed_image> gll::load_compressed_image(
+    const char*                 filepath,
+    const image_load_settings&  image_settings,
+    const compression_settings& settings
+)
+{
+    uint64_t key = 0;
+
+    if (!image_settings.cache_directory.empty())
+    {
+        key = hash_value(14695981039346656037ull, cooked_blocks_version);
+        key = hash_image_load_settings(key, image_settings);
+        key = hash_compression_settings(key, settings);
+        key = hash_source_file(key, filepath);
+    }
+
+    const std::string cooked_path = key ? cooked_file_path(image_settings.cache_directory, key, ".gllblocks") : std::string();
+
+    if (key)
+    {
+        auto cooked = read_cooked_blocks(cooked_path, key);
+        if (cooked.first)
+            return cooked;
+    }
+
+    auto img = load_image(filepath, image_settings);
+    if (!img.first)
+        return {false, {}};
+
+    auto output = compress_image(img.second, settings);
+    free_image(img.second);
+
+    if (key && output.first)
+        write_cooked_blocks(cooked_path, key, output.second);
+
+    return output;
+}
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/ProgressHandler.hpp>
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/config.h>
+
+size_t attribute_components(
+    gll::model::attribute       attrib,
+    const model_load_settings&  settings
+)
+{
+    switch (attrib)
+    {
+    case gll::model::attribute::position:              return 3;
+    case gll::model::attribute::normal:                return 3;
+    case gll::model::attribute::texcoord:              return 2;
+    case gll::model::attribute::tangents_bitangents:   return 6;
+    case gll::model::attribute::bones_indices:         return settings.max_influencial_bones;
+    case gll::model::attribute::bones_weights:         return settings.max_influencial_bones;
+    }
+    return 0;
+}
+
+//Bone indices are the only attribute stored outside of the float vertex streams
+bool is_float_attribute(gll::model::attribute attrib)
+{
+    return attrib != gll::model::attribute::bones_indices;
+}
+
+size_t component_size(model::component_type type)
+{
+    switch (type)
+    {
+    case model::component_type::float32:   return 4;
+    case model::component_type::uint32:    return 4;
+    case model::component_type::uint16:    return 2;
+    case model::component_type::uint8:     return 1;
+    }
+    return 0;
+}
+
+//Vertex layout engine
+//The attribute set of a mesh is resolved once into a list of copy operations,
+//each of which is then executed as a tight loop over all vertices.
+
+struct vertex_copy_op
+{
+    const float*    source;         //nullptr - fill with fill_value
+    size_t          source_stride;  //in floats
+    size_t          components;
+    bool            swap_yz;
+    float           fill_value;
+
+    float*          target;
+    size_t          target_stride;  //in floats
+
+    bounds_accumulator* bounds = nullptr;   //of the written vectors, for positions
+};
+
+template<size_t components, bool swap_yz>
+void copy_vertex_components(const vertex_copy_op& op, size_t vertices_count)
+{
+    const float* src = op.source;
+    float* dst = op.target;
+
+    for (size_t i = 0; i < vertices_count; i++)
+    {
+        if constexpr (swap_yz)
+        {
+            dst[0] = src[0];
+            dst[1] = src[2];
+            dst[2] = src[1];
+
+            if (op.bounds)
+                op.bounds->add(dst);
+        }
+        else
+        {
+            for (size_t c = 0; c < components; c++)
+                dst[c] = src[c];
+        }
+        src += op.source_stride;
+        dst += op.target_stride;
+    }
+}
+
+void copy_vertex_components_dynamic(const vertex_copy_op& op, size_t vertices_count)
+{
+    const float* src = op.source;
+    float* dst = op.target;
+
+    for (size_t i = 0; i < vertices_count; i++)
+    {
+        for (size_t c = 0; c < op.components; c++)
+            dst[c] = src[c];
+        src += op.source_stride;
+        dst += op.target_stride;
+    }
+}
+
+void fill_vertex_components(const vertex_copy_op& op, size_t vertices_count)
+{
+    float* dst = op.target;
+
+    for (size_t i = 0; i < vertices_count; i++)
+    {
+        for (size_t c = 0; c < op.components; c++)
+            dst[c] = op.fill_value;
+        dst += op.target_stride;
+    }
+}
+
+void execute_vertex_copy_op(const vertex_copy_op& op, size_t vertices_count)
+{
+    if (!op.source)
+        return fill_vertex_components(op, vertices_count);
+
+    if (op.swap_yz && op.source_stride == 3 && op.target_stride == 3)
+        return swizzle_yz_vec3(op.source, op.target, vertices_count, op.bounds);
+
+    if (op.swap_yz)
+        return copy_vertex_components<3, true>(op, vertices_count);
+
+    switch (op.components)
+    {
+    case 2: return copy_vertex_components<2, false>(op, vertices_count);
+    case 3: return copy_vertex_components<3, false>(op, vertices_count);
+    case 4: return copy_vertex_components<4, false>(op, vertices_count);
+    }
+
+    copy_vertex_components_dynamic(op, vertices_count);
+}
+
+//Fused loop for the common interleaved layouts: position followed by any of normal,
+//texcoord and tangents_bitangents, all present in the source mesh.
+template<bool normal, bool texcoord, bool tangents>
+void copy_interleaved_vertices(const aiMesh* mesh, float* target, size_t vertices_count, bounds_accumulator& bounds)
+{
+    constexpr size_t stride = 3 + (normal ? 3 : 0) + (texcoord ? 2 : 0) + (tangents ? 6 : 0);
+
+    size_t i = 0;
+
+#if defined(GLL_SSE2)
+    //Swizzle and interleave position, normal and texcoord in two 4 float stores.
+    //aiVector3D loads read one float past the vector, so the last vertex is left to the scalar loop.
+    if constexpr (normal && texcoord)
+    {
+        const float* positions = reinterpret_cast<const float*>(mesh->mVertices);
+        const float* normals   = reinterpret_cast<const float*>(mesh->mNormals);
+        const float* texcoords = reinterpret_cast<const float*>(mesh->mTextureCoords[0]);
+        const float* tangent_vectors   = reinterpret_cast<const float*>(mesh->mTangents);
+        const float* bitangent_vectors = reinterpret_cast<const float*>(mesh->mBitangents);
+
+        //Bounds of the source positions, the 4th lane belongs to the next vector
+        __m128 low = _mm_set1_ps(INFINITY), high = _mm_set1_ps(-INFINITY);
+
+        for (; i + 1 < vertices_count; i++)
+        {
+            float* dst = target + i * stride;
+
+            __m128 p = _mm_loadu_ps(positions + i * 3);
+            low = _mm_min_ps(low, p);
+            high = _mm_max_ps(high, p);
+            __m128 n = _mm_loadu_ps(normals + i * 3);
+            __m128 t = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(texcoords + i * 3)));
+
+            __m128 pz_py_nx = _mm_shuffle_ps(p, n, _MM_SHUFFLE(0, 0, 1, 2));
+            _mm_storeu_ps(dst + 0, _mm_shuffle_ps(p, pz_py_nx, _MM_SHUFFLE(2, 1, 2, 0)));
+            _mm_storeu_ps(dst + 4, _mm_shuffle_ps(n, t, _MM_SHUFFLE(1, 0, 1, 2)));
+
+            if constexpr (tangents)
+            {
+                __m128 tg = _mm_loadu_ps(tangent_vectors + i * 3);
+                __m128 bt = _mm_loadu_ps(bitangent_vectors + i * 3);
+
+                __m128 tz_ty_bx = _mm_shuffle_ps(tg, bt, _MM_SHUFFLE(0, 0, 1, 2));
+                _mm_storeu_ps(dst + 8, _mm_shuffle_ps(tg, tz_ty_bx, _MM_SHUFFLE(2, 1, 2, 0)));
+                _mm_storel_pi(reinterpret_cast<__m64*>(dst + 12), _mm_shuffle_ps(bt, bt, _MM_SHUFFLE(0, 0, 1, 2)));
+            }
+        }
+
+        float lanes_low[4], lanes_high[4];
+        _mm_storeu_ps(lanes_low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm_storeu_ps(lanes_high, _mm_shuffle_ps(high, high, _MM_SHUFFLE(3, 1, 2, 0)));
+        bounds.add_lanes(lanes_low, lanes_high, 3);
+    }
+#endif
+
+    for (; i < vertices_count; i++)
+    {
+        float* dst = target + i * stride;
+
+        const aiVector3D& p = mesh->mVertices[i];
+        *dst++ = p.x; *dst++ = p.z; *dst++ = p.y;
+        bounds.add(dst - 3);
+
+        if constexpr (normal)
+        {
+            const aiVector3D& n = mesh->mNormals[i];
+            *dst++ = n.x; *dst++ = n.z; *dst++ = n.y;
+        }
+        if constexpr (texcoord)
+        {
+            const aiVector3D& t = mesh->mTextureCoords[0][i];
+            *dst++ = t.x; *dst++ = t.y;
+        }
+        if constexpr (tangents)
+        {
+            const aiVector3D& t = mesh->mTangents[i];
+            const aiVector3D& b = mesh->mBitangents[i];
+            *dst++ = t.x; *dst++ = t.z; *dst++ = t.y;
+            *dst++ = b.x; *dst++ = b.z; *dst++ = b.y;
+        }
+    }
+}
+
+bool try_copy_interleaved_vertices(
+    const aiMesh*                           mesh,
+    const std::set<gll::model::attribute>&  attribs,
+    float*                                  target,
+    size_t                                  vertices_count,
+    bounds_accumulator&                     bounds
+)
+{
+    if (!mesh->HasPositions() || !attribs.count(model::attribute::position))
+        return false;
+
+    bool normal = false, texcoord = false, tangents = false;
+
+    for (auto& attrib : attribs)
+    {
+        switch (attrib)
+        {
+        case model::attribute::position:                                                                    break;
+        case model::attribute::normal:              if (!mesh->HasNormals())                return false;   normal = true;      break;
+        case model::attribute::texcoord:            if (!mesh->HasTextureCoords(0))         return false;   texcoord = true;    break;
+        case model::attribute::tangents_bitangents: if (!mesh->HasTangentsAndBitangents())  return false;   tangents = true;    break;
+        default:                                                                            return false;
+        }
+    }
+
+    using copy_fn = void(*)(const aiMesh*, float*, size_t, bounds_accumulator&);
+    static const copy_fn variants[8] = {
+        copy_interleaved_vertices<false, false, false>,
+        copy_interleaved_vertices<false, false, true>,
+        copy_interleaved_vertices<false, true,  false>,
+        copy_interleaved_vertices<false, true,  true>,
+        copy_interleaved_vertices<true,  false, false>,
+        copy_interleaved_vertices<true,  false, true>,
+        copy_interleaved_vertices<true,  true,  false>,
+        copy_interleaved_vertices<true,  true,  true>
+    };
+
+    variants[normal * 4 + texcoord * 2 + tangents](mesh, target, vertices_count, bounds);
+    return true;
+}
+
+//Skinning
+
+//Converts into the y/z swapped space of the loaded vertices, that is P * m * P with P swapping y and z
+std::array<std::array<float, 4>, 4> convert_assimp_matrix(const aiMatrix4x4& m)
+{
+    static const unsigned int axis[4] = {0, 2, 1, 3};
+
+    std::array<std::array<float, 4>, 4> output;
+    for (unsigned int r = 0; r < 4; r++)
+        for (unsigned int c = 0; c < 4; c++)
+            output[r][c] = m[axis[r]][axis[c]];
+
+    return output;
+}
+
+//Assigns ids to the bones in the order the meshes reference them
+void register_assimp_bones(
+    model&                              output,
+    const std::vector<const aiMesh*>&   meshes
+)
+{
+    for (auto mesh : meshes)
+    {
+        for (unsigned int b = 0; b < mesh->mNumBones; b++)
+        {
+            const aiBone* bone = mesh->mBones[b];
+            if (output.bones.count(bone->mName.C_Str()))
+                continue;
+
+            auto offset = convert_assimp_matrix(bone->mOffsetMatrix);
+
+            output.bones.insert({bone->mName.C_Str(), {
+                (int)output.bones.size(),
+                offset[0],
+                offset[1],
+                offset[2],
+                offset[3]
+            }});
+        }
+    }
+}
+
+//Strongest max_influencial_bones influences of every vertex, renormalized to sum up to 1
+struct vertex_skinning
+{
+    std::vector<unsigned int>   indices;    //0 for unused slots
+    std::vector<float>          weights;
+};
+
+void build_vertex_skinning(
+    vertex_skinning&            output,
+    const aiMesh*               mesh,
+    const model&                mod,
+    const model_load_settings&  settings
+)
+{
+    const size_t vertices_count = mesh->mNumVertices;
+    const size_t slots = settings.max_influencial_bones;
+
+    output.indices.assign(vertices_count * slots, 0);
+    output.weights.assign(vertices_count * slots, 0.0f);
+
+    //Every weight either takes the slot of the weakest influence of its vertex or is dropped
+
+    for (unsigned int b = 0; b < mesh->mNumBones; b++)
+    {
+        const aiBone* bone = mesh->mBones[b];
+        const int id = mod.bones.at(bone->mName.C_Str()).id;
+
+        for (unsigned int w = 0; w < bone->mNumWeights; w++)
+        {
+            const aiVertexWeight& weight = bone->mWeights[w];
+            if (weight.mVertexId >= vertices_count)
+                continue;
+
+            unsigned int* vertex_ids = output.indices.data() + weight.mVertexId * slots;
+            float* vertex_weights = output.weights.data() + weight.mVertexId * slots;
+
+            size_t weakest = 0;
+            for (size_t s = 1; s < slots; s++)
+                if (vertex_weights[s] < vertex_weights[weakest])
+                    weakest = s;
+
+            if (weight.mWeight > vertex_weights[weakest])
+            {
+                vertex_ids[weakest] = (unsigned int)id;
+                vertex_weights[weakest] = weight.mWeight;
+            }
+        }
+    }
+
+    for (size_t v = 0; v < vertices_count; v++)
+    {
+        float* vertex_weights = output.weights.data() + v * slots;
+
+        float sum = 0;
+        for (size_t s = 0; s < slots; s++)
+            sum += vertex_weights[s];
+
+        if (sum > 0)
+            for (size_t s = 0; s < slots; s++)
+                vertex_weights[s] /= sum;
+    }
+}
+
+//Narrows the bone ids to the integer type of the mesh
+void store_bones_indices(
+    model::mesh&                outmesh,
+    const vertex_skinning&      skinning,
+    const model_load_settings&  settings
+)
+{
+    const size_t count = outmesh.vertices_count * settings.max_influencial_bones;
+    const size_t size = component_size(settings.bones_indices_type);
+
+    outmesh.bones_indices_type = settings.bones_indices_type;
+    outmesh.bones_indices.assign(count * size, 0);
+
+    if (skinning.indices.empty())
+        return;
+
+    uint8_t* target = outmesh.bones_indices.data();
+    for (size_t i = 0; i < count; i++)
+    {
+        switch (settings.bones_indices_type)
+        {
+        case model::component_type::uint8:  target[i] = (uint8_t)skinning.indices[i]; break;
+        case model::component_type::uint16: reinterpret_cast<uint16_t*>(target)[i] = (uint16_t)skinning.indices[i]; break;
+        default:                            reinterpret_cast<uint32_t*>(target)[i] = skinning.indices[i]; break;
+        }
+    }
+}
+
+//Appends the copy operations writing attrib to target, starting at the given vertex offset.
+//The position copy adds the positions to bounds.
+void plan_vertex_attrib(
+    std::vector<vertex_copy_op>&    plan,
+    gll::model::attribute           attrib,
+    const aiMesh*                   mesh,
+    const vertex_skinning&          skinning,
+    bounds_accumulator&             bounds,
+    float*                          target,
+    size_t                          target_stride,
+    const model_load_settings&      settings
+)
+{
+    auto vectors = [](const aiVector3D* v){ return reinterpret_cast<const float*>(v); };
+
+    auto copy = [&](const float* source, size_t components, bool swap_yz, size_t offset){
+        plan.push_back({source, 3, components, swap_yz, 0.0f, target + offset, target_stride});
+    };
+
+    auto fill = [&](size_t components, float value){
+        plan.push_back({nullptr, 0, components, false, value, target, target_stride});
+    };
+
+    switch (attrib)
+    {
+    case model::attribute::position:
+        if (!mesh->HasPositions())              return fill(3, 0);
+        copy(vectors(mesh->mVertices), 3, true, 0);
+        plan.back().bounds = &bounds;
+        return;
+    case model::attribute::normal:
+        if (!mesh->HasNormals())                return fill(3, 0);
+        return copy(vectors(mesh->mNormals), 3, true, 0);
+    case model::attribute::texcoord:
+        if (!mesh->HasTextureCoords(0))         return fill(2, 0);
+        return copy(vectors(mesh->mTextureCoords[0]), 2, false, 0);
+    case model::attribute::tangents_bitangents:
+        if (!mesh->HasTangentsAndBitangents())  return fill(6, 0);
+        copy(vectors(mesh->mTangents), 3, true, 0);
+        copy(vectors(mesh->mBitangents), 3, true, 3);
+        return;
+    case model::attribute::bones_indices:
+        return;     //see store_bones_indices
+    case model::attribute::bones_weights:
+        if (!mesh->HasBones())                  return fill(settings.max_influencial_bones, 0);
+        plan.push_back({skinning.weights.data(), (size_t)settings.max_influencial_bones, (size_t)settings.max_influencial_bones, false, 0.0f, target, target_stride});
+        return;
+    }
+}
+
+//Moves the vertex streams and indicies of a mesh into a single aligned allocation
+void pack_mesh_storage(
+    model::mesh&                mesh,
+    const model_load_settings&  settings
+)
+{
+    auto align = [](size_t value){
+        constexpr size_t a = 16;
+        return (value + a - 1) & ~(a - 1);
+    };
+
+    //Compute layout
+
+    size_t size = 0;
+    std::vector<size_t> streams_offsets;
+
+    for (auto& stream : mesh.vertices)
+    {
+        streams_offsets.push_back(size);
+        size = align(size + stream.size() * sizeof(float));
+    }
+
+    const size_t bones_indices_offset = size;
+    size = align(size + mesh.bones_indices.size());
+
+    const bool compact = mesh.indicies_type == model::component_type::uint16;
+    const void* indicies = compact ? (const void*)mesh.indicies_16.data() : (const void*)mesh.indicies.data();
+    const size_t indicies_bytes = compact ? mesh.indicies_16.size() * sizeof(uint16_t) : mesh.indicies.size() * sizeof(uint32_t);
+
+    mesh.indicies_offset = size;
+    mesh.indicies_count = compact ? mesh.indicies_16.size() : mesh.indicies.size();
+    size += indicies_bytes;
+
+    mesh.layout.clear();
+    auto stream = mesh.vertices.begin();
+    auto stream_offset = streams_offsets.begin();
+    size_t offset_in_vertex = 0;
+
+    for (auto& attrib : mesh.attributes)
+    {
+        const size_t components = attribute_components(attrib, settings);
+
+        if (!is_float_attribute(attrib))
+        {
+            const size_t size = component_size(mesh.bones_indices_type);
+            mesh.layout.push_back({attrib, bones_indices_offset, components * size, (uint8_t)components, mesh.bones_indices_type});
+            continue;
+        }
+
+        const size_t stride = mesh.vertices_count ? stream->size() / mesh.vertices_count : 0;
+
+        mesh.layout.push_back({
+            attrib,
+            *stream_offset + offset_in_vertex * sizeof(float),
+            stride * sizeof(float),
+            (uint8_t)components,
+            model::component_type::float32
+        });
+
+        offset_in_vertex += components;
+
+        if (!settings.interleave_attributes)
+        {
+            stream++;
+            stream_offset++;
+            offset_in_vertex = 0;
+        }
+    }
+
+    //Copy data
+
+    mesh.storage = ::operator new(size, std::align_val_t(model::mesh::storage_alignment));
+    mesh.storage_size = size;
+    uint8_t* storage = static_cast<uint8_t*>(mesh.storage);
+
+    stream_offset = streams_offsets.begin();
+    for (auto& stream : mesh.vertices)
+        std::memcpy(storage + *stream_offset++, stream.data(), stream.size() * sizeof(float));
+
+    std::memcpy(storage + bones_indices_offset, mesh.bones_indices.data(), mesh.bones_indices.size());
+    std::memcpy(storage + mesh.indicies_offset, indicies, indicies_bytes);
+
+    mesh.vertices.clear();
+    mesh.bones_indices = {};
+    mesh.indicies = {};
+    mesh.indicies_16 = {};
+}
+
+//Narrows the indicies to 16 bits when every vertex is addressable
+void compact_mesh_indicies(model::mesh& mesh)
+{
+    if (mesh.vertices_count > 65536)
+        return;
+
+    mesh.indicies_16.resize(mesh.indicies.size());
+    for (size_t i = 0; i < mesh.indicies.size(); i++)
+        mesh.indicies_16[i] = (uint16_t)mesh.indicies[i];
+
+    mesh.indicies = {};
+    mesh.indicies_type = model::component_type::uint16;
+}
+
+//Converts a fully loaded mesh into the output formats requested by the settings
+void finalize_mesh(
+    model::mesh&                mesh,
+    const model_load_settings&  settings
+)
+{
+    if (settings.compact_indicies)
+        compact_mesh_indicies(mesh);
+
+    if (settings.contiguous_storage)
+        pack_mesh_storage(mesh, settings);
+}
+
+model::primitive_type convert_assimp_primitive_types(unsigned int types)
+{
+    switch (types)
+    {
+    case aiPrimitiveType_TRIANGLE:  return model::primitive_type::triangles;
+    case aiPrimitiveType_POINT:     return model::primitive_type::points;
+    case aiPrimitiveType_LINE:      return model::primitive_type::lines;
+    default:                        return model::primitive_type::mixed;
+    }
+}
+
+void load_assimp_indicies(
+    model::mesh&                outmesh,
+    const aiMesh*               mesh
+)
+{
+    //aiProcess_Triangulate leaves only triangles, unless the mesh has points or lines
+    if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+    {
+        outmesh.indicies.resize(mesh->mNumFaces * 3);
+        unsigned int* target = outmesh.indicies.data();
+
+        for (unsigned int face_id = 0; face_id < mesh->mNumFaces; face_id++)
+        {
+            const unsigned int* face = mesh->mFaces[face_id].mIndices;
+            target[0] = face[0];
+            target[1] = face[1];
+            target[2] = face[2];
+            target += 3;
+        }
+        return;
+    }
+
+    size_t count = 0;
+    for (unsigned int face_id = 0; face_id < mesh->mNumFaces; face_id++)
+        count += mesh->mFaces[face_id].mNumIndices;
+
+    outmesh.indicies.resize(count);
+    unsigned int* target = outmesh.indicies.data();
+
+    for (unsigned int face_id = 0; face_id < mesh->mNumFaces; face_id++)
+    {
+        const aiFace& face = mesh->mFaces[face_id];
+        std::memcpy(target, face.mIndices, face.mNumIndices * sizeof(unsigned int));
+        target += face.mNumIndices;
+    }
+}
+
+//Bounding volumes of positions that are already in place, see bounds_accumulator
+
+void compute_bounding_volume(
+    model::bounding_volume&     output,
+    const float*                positions,
+    size_t                      stride,     //in floats, at least 3
+    size_t                      count
+)
+{
+    bounds_accumulator bounds;
+    for (size_t i = 0; i < count; i++)
+        bounds.add(positions + i * stride);
+    bounds.finish(output);
+}
+
+void process_assimp_mesh(
+    model::mesh&                outmesh,
+    const model&                output,
+    const model_load_settings&  settings,
+    const aiMesh*               mesh
+)
+{
+    //Setup mesh
+
+    outmesh.material_id = mesh->mMaterialIndex;
+    outmesh.primitives = convert_assimp_primitive_types(mesh->mPrimitiveTypes);
+
+    //Load Indicies
+
+    load_assimp_indicies(outmesh, mesh);
+
+    //Findout vertex layout
+
+    std::set<gll::model::attribute> model_attribs;
+    if (mesh->HasPositions())               model_attribs.insert(gll::model::attribute::position);
+    if (mesh->HasNormals())                 model_attribs.insert(gll::model::attribute::normal);
+    if (mesh->HasTextureCoords(0))          model_attribs.insert(gll::model::attribute::texcoord);
+    if (mesh->HasTangentsAndBitangents())   model_attribs.insert(gll::model::attribute::tangents_bitangents);
+    if (mesh->HasBones()) {
+        model_attribs.insert(gll::model::attribute::bones_indices);
+        model_attribs.insert(gll::model::attribute::bones_weights);
+    };
+
+    model_attribs.insert(
+        settings.force_attributes.begin(),
+        settings.force_attributes.end()
+    );
+
+    outmesh.attributes = model_attribs;
+
+    //Create containers for vertices and plan the copy
+
+    const size_t vertices_count = mesh->mNumVertices;
+    outmesh.vertices_count = vertices_count;
+    std::vector<vertex_copy_op> plan;
+    bounds_accumulator bounds;
+
+    vertex_skinning skinning;
+    if (mesh->HasBones() && settings.max_influencial_bones > 0 && (
+        model_attribs.count(model::attribute::bones_indices) || model_attribs.count(model::attribute::bones_weights)
+    ))
+        build_vertex_skinning(skinning, mesh, output, settings);
+
+    if (settings.interleave_attributes)
+    {
+        outmesh.vertices.push_back({});
+        auto& target = outmesh.vertices.back();
+
+        size_t vertex_length = 0;
+        for (auto& attrib : model_attribs)
+            if (is_float_attribute(attrib))
+                vertex_length += attribute_components(attrib, settings);
+
+        target.resize(vertex_length * vertices_count);
+
+        if (!try_copy_interleaved_vertices(mesh, model_attribs, target.data(), vertices_count, bounds))
+        {
+            size_t offset = 0;
+            for (auto& attrib : model_attribs)
+            {
+                if (!is_float_attribute(attrib))
+                    continue;
+
+                plan_vertex_attrib(plan, attrib, mesh, skinning, bounds, target.data() + offset, vertex_length, settings);
+                offset += attribute_components(attrib, settings);
+            }
+        }
+    }
+    else
+    {
+        for (auto& attrib : model_attribs)
+        {
+            if (!is_float_attribute(attrib))
+                continue;
+
+            const size_t components = attribute_components(attrib, settings);
+
+            outmesh.vertices.push_back({});
+            auto& target = outmesh.vertices.back();
+            target.resize(vertices_count * components);
+
+            plan_vertex_attrib(plan, attrib, mesh, skinning, bounds, target.data(), components, settings);
+        }
+    }
+
+    //Load Vertices
+
+    for (auto& op : plan)
+        execute_vertex_copy_op(op, vertices_count);
+
+    bounds.finish(outmesh.bounds);
+
+    if (model_attribs.count(model::attribute::bones_indices))
+        store_bones_indices(outmesh, skinning, settings);
+}
+
+//Flattens the node hierarchy in depth first order. Meshes keep their index in the scene.
+void collect_assimp_nodes(
+    std::vector<model::node>&   output,
+    const aiNode*               node,
+    int                         parent
+)
+{
+    const int id = (int)output.size();
+
+    output.push_back({
+        node->mName.C_Str(),
+        parent,
+        convert_assimp_matrix(node->mTransformation),
+        std::vector<unsigned int>(node->mMeshes, node->mMeshes + node->mNumMeshes)
+    });
+
+    for(unsigned int i = 0; i < node->mNumChildren; i++)
+        collect_assimp_nodes(output, node->mChildren[i], id);
+}
+
+//Mesh processing
+
+bool is_processable_mesh(const model::mesh& mesh)
+{
+    return !mesh.storage
+        && mesh.primitives == model::primitive_type::triangles
+        && mesh.indicies_type == model::component_type::uint32
+        && mesh.indicies.size() % 3 == 0;
+}
+
+//Post transform cache misses per triangle with a FIFO cache
+float compute_acmr(const std::vector<unsigned int>& indicies, size_t vertices_count, size_t cache_size)
+{
+    if (indicies.empty() || cache_size == 0)
+        return 0;
+
+    //A vertex is in the cache when it was inserted less than cache_size misses ago
+    std::vector<size_t> inserted_at(vertices_count, 0);
+    size_t misses = 0;
+
+    for (auto index : indicies)
+    {
+        if (inserted_at[index] && misses - inserted_at[index] < cache_size)
+            continue;
+
+        misses++;
+        inserted_at[index] = misses;
+    }
+
+    return (float)misses / (indicies.size() / 3);
+}
+
+//Tom Forsyth's linear-speed vertex cache optimisation
+std::vector<unsigned int> forsyth_reorder_triangles(
+    const std::vector<unsigned int>&    indicies,
+    size_t                              vertices_count,
+    size_t                              cache_size
+)
+{
+    const size_t triangles_count = indicies.size() / 3;
+
+    //Vertex to triangles adjacency
+
+    std::vector<unsigned int> adjacency_offsets(vertices_count + 1, 0);
+    for (auto index : indicies)
+        adjacency_offsets[index + 1]++;
+    for (size_t v = 0; v < vertices_count; v++)
+        adjacency_offsets[v + 1] += adjacency_offsets[v];
+
+    std::vector<unsigned int> adjacency(indicies.size());
+    std::vector<unsigned int> remaining(vertices_count, 0);
+    for (size_t t = 0; t < triangles_count; t++)
+        for (size_t k = 0; k < 3; k++)
+        {
+            unsigned int v = indicies[t * 3 + k];
+            adjacency[adjacency_offsets[v] + remaining[v]++] = (unsigned int)t;
+        }
+
+    //Scoring
+
+    auto vertex_score = [&](int cache_position, unsigned int remaining_triangles){
+        if (remaining_triangles == 0)
+            return -1.0f;
+
+        float score = 0;
+        if (cache_position >= 0)
+        {
+            if (cache_position < 3)
+                score = 0.75f;
+            else
+                score = std::pow(1.0f - (float)(cache_position - 3) / (cache_size - 3), 1.5f);
+        }
+
+        return score + 2.0f / std::sqrt((float)remaining_triangles);
+    };
+
+    std::vector<int>    cache_position(vertices_count, -1);
+    std::vector<float>  vertex_scores(vertices_count);
+    std::vector<float>  triangle_scores(triangles_count, 0);
+    std::vector<bool>   emitted(triangles_count, false);
+
+    for (size_t v = 0; v < vertices_count; v++)
+        vertex_scores[v] = vertex_score(-1, remaining[v]);
+
+    for (size_t t = 0; t < triangles_count; t++)
+        for (size_t k = 0; k < 3; k++)
+            triangle_scores[t] += vertex_scores[indicies[t * 3 + k]];
+
+    //Greedy emission
+
+    std::vector<unsigned int> output;
+    output.reserve(indicies.size());
+
+    std::vector<unsigned int> cache, next_cache;
+    cache.reserve(cache_size + 3);
+    next_cache.reserve(cache_size + 3);
+
+    size_t next_unemitted = 0;
+    long long best = -1;
+
+    for (size_t emitted_count = 0; emitted_count < triangles_count; emitted_count++)
+    {
+        //Without a candidate from the cache continue with the next triangle in input order
+        if (best < 0)
+        {
+            while (emitted[next_unemitted])
+                next_unemitted++;
+            best = (long long)next_unemitted;
+        }
+
+        const unsigned int* triangle = &indicies[best * 3];
+        emitted[best] = true;
+
+        next_cache.assign(triangle, triangle + 3);
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            unsigned int v = triangle[k];
+            output.push_back(v);
+
+            //Remove the triangle from the vertex adjacency
+            unsigned int* begin = &adjacency[adjacency_offsets[v]];
+            unsigned int* end = begin + remaining[v];
+            *std::find(begin, end, (unsigned int)best) = *(end - 1);
+            remaining[v]--;
+        }
+
+        for (auto v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                next_cache.push_back(v);
+
+        //Rescore the cached and just evicted vertices and their triangles
+
+        for (size_t i = 0; i < next_cache.size(); i++)
+        {
+            unsigned int v = next_cache[i];
+            cache_position[v] = i < cache_size ? (int)i : -1;
+        }
+
+        best = -1;
+        float best_score = -1;
+
+        for (auto v : next_cache)
+        {
+            float score = vertex_score(cache_position[v], remaining[v]);
+            float delta = score - vertex_scores[v];
+            vertex_scores[v] = score;
+
+            for (unsigned int a = 0; a < remaining[v]; a++)
+            {
+                unsigned int t = adjacency[adjacency_offsets[v] + a];
+                triangle_scores[t] += delta;
+
+                if (triangle_scores[t] > best_score)
+                {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+        }
+
+        if (next_cache.size() > cache_size)
+            next_cache.resize(cache_size);
+        std::swap(cache, next_cache);
+    }
+
+    return output;
+}
+
+bool gll::optimize_vertex_cache(model::mesh& mesh, size_t cache_size)
+{
+    if (!is_processable_mesh(mesh) || cache_size < 4)
+        return false;
+
+    const size_t vertices_count = mesh.vertices_count;
+    mesh.statistics.acmr_before = compute_acmr(mesh.indicies, vertices_count, cache_size);
+
+    mesh.indicies = forsyth_reorder_triangles(mesh.indicies, vertices_count, cache_size);
+
+    //Renumber the vertices in the order of first use, unreferenced ones go last
+
+    const unsigned int unassigned = ~0u;
+    std::vector<unsigned int> remap(vertices_count, unassigned);
+    unsigned int next = 0;
+
+    for (auto& index : mesh.indicies)
+    {
+        if (remap[index] == unassigned)
+            remap[index] = next++;
+        index = remap[index];
+    }
+
+    for (auto& index : remap)
+        if (index == unassigned)
+            index = next++;
+
+    for (auto& lod : mesh.lods)
+        for (auto& index : lod.indicies)
+            index = remap[index];
+
+    for (auto& index : mesh.meshlet_vertices)
+        index = remap[index];
+
+    for (auto& stream : mesh.vertices)
+    {
+        const size_t stride = vertices_count ? stream.size() / vertices_count : 0;
+        std::vector<float> reordered(stream.size());
+
+        for (size_t v = 0; v < vertices_count; v++)
+            std::memcpy(&reordered[remap[v] * stride], &stream[v * stride], stride * sizeof(float));
+
+        stream = std::move(reordered);
+    }
+
+    if (vertices_count && !mesh.bones_indices.empty())
+    {
+        const size_t stride = mesh.bones_indices.size() / vertices_count;
+        std::vector<uint8_t> reordered(mesh.bones_indices.size());
+
+        for (size_t v = 0; v < vertices_count; v++)
+            std::memcpy(&reordered[remap[v] * stride], &mesh.bones_indices[v * stride], stride);
+
+        mesh.bones_indices = std::move(reordered);
+    }
+
+    mesh.statistics.acmr_after = compute_acmr(mesh.indicies, vertices_count, cache_size);
+    return true;
+}
+
+//Vertex welding
+//Every vertex becomes a key of 32 bit words, packed one after another: its floats, either as they are
+//or rounded to multiples of the epsilon, followed by its bone ids. Keys are looked up in an open
+//addressing table; equal keys share the first vertex that had them.
+
+//Writes round(source[i] * inverse) as floats, -0 turned into 0 so that both sides of zero match
+void quantize_floats(const float* source, float* target, size_t count, float inverse)
+{
+    size_t i = 0;
+
+#if defined(GLL_SSE2)
+    //Adding and subtracting 1.5 * 2^23 rounds floats below 2^23 to the nearest integer, bigger ones already are
+    const __m128 magic = _mm_set1_ps(12582912.0f);
+    const __m128 limit = _mm_set1_ps(8388608.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 scale = _mm_set1_ps(inverse);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 x = _mm_mul_ps(_mm_loadu_ps(source + i), scale);
+        const __m128 small = _mm_cmplt_ps(_mm_andnot_ps(sign, x), limit);
+        const __m128 rounded = _mm_sub_ps(_mm_add_ps(x, magic), magic);
+        const __m128 output = _mm_or_ps(_mm_and_ps(small, rounded), _mm_andnot_ps(small, x));
+        _mm_storeu_ps(target + i, _mm_add_ps(output, _mm_setzero_ps()));
+    }
+#endif
+
+    for (; i < count; i++)
+        target[i] = std::nearbyint(source[i] * inverse) + 0.0f;
+}
+
+uint64_t hash_weld_key(const uint32_t* key, size_t words)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+    for (size_t w = 0; w < words; w++)
+    {
+        hash = (hash ^ key[w]) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+bool gll::weld_vertices(model::mesh& mesh, float epsilon)
+{
+    if (mesh.storage || mesh.indicies_type != model::component_type::uint32 || !(epsilon >= 0))
+        return false;
+
+    const size_t vertices_count = mesh.vertices_count;
+    mesh.statistics.vertices_before = vertices_count;
+    mesh.statistics.vertices_after = vertices_count;
+
+    if (!vertices_count)
+        return true;
+
+    //Keys
+
+    std::vector<size_t> strides;
+    size_t floats = 0;
+    for (auto& stream : mesh.vertices)
+    {
+        strides.push_back(stream.size() / vertices_count);
+        floats += strides.back();
+    }
+
+    const size_t bones_stride = mesh.bones_indices.size() / vertices_count;
+    const size_t words = floats + (bones_stride + 3) / 4;
+    std::vector<uint32_t> keys(vertices_count * words, 0);
+
+    size_t offset = 0, s = 0;
+    for (auto& stream : mesh.vertices)
+    {
+        const size_t stride = strides[s++];
+        for (size_t v = 0; v < vertices_count; v++)
+        {
+            float* key = reinterpret_cast<float*>(&keys[v * words + offset]);
+            if (epsilon > 0)
+                quantize_floats(&stream[v * stride], key, stride, 1.0f / epsilon);
+            else
+                std::memcpy(key, &stream[v * stride], stride * sizeof(float));
+        }
+        offset += stride;
+    }
+
+    for (size_t v = 0; v < vertices_count && bones_stride; v++)
+        std::memcpy(&keys[v * words + floats], &mesh.bones_indices[v * bones_stride], bones_stride);
+
+    //Lookup, the table is at most half full
+
+    size_t capacity = 1;
+    while (capacity < vertices_count * 2)
+        capacity *= 2;
+
+    const unsigned int empty = ~0u;
+    std::vector<unsigned int> table(capacity, empty);
+    std::vector<unsigned int> remap(vertices_count);
+    std::vector<unsigned int> kept;
+
+    for (size_t v = 0; v < vertices_count; v++)
+    {
+        const uint32_t* key = &keys[v * words];
+        size_t slot = hash_weld_key(key, words) & (capacity - 1);
+
+        while (table[slot] != empty && std::memcmp(&keys[table[slot] * words], key, words * sizeof(uint32_t)))
+            slot = (slot + 1) & (capacity - 1);
+
+        if (table[slot] == empty)
+        {
+            table[slot] = (unsigned int)v;
+            remap[v] = (unsigned int)kept.size();
+            kept.push_back((unsigned int)v);
+        }
+        else
+            remap[v] = remap[table[slot]];
+    }
+
+    //Compaction
+
+    for (auto& index : mesh.indicies)
+        index = remap[index];
+
+    for (auto& lod : mesh.lods)
+        for (auto& index : lod.indicies)
+            index = remap[index];
+
+    for (auto& index : mesh.meshlet_vertices)
+        index = remap[index];
+
+    if (kept.size() == vertices_count)
+        return true;
+
+    s = 0;
+    for (auto& stream : mesh.vertices)
+    {
+        const size_t stride = strides[s++];
+        std::vector<float> welded(kept.size() * stride);
+
+        for (size_t v = 0; v < kept.size(); v++)
+            std::memcpy(&welded[v * stride], &stream[kept[v] * stride], stride * sizeof(float));
+
+        stream = std::move(welded);
+    }
+
+    if (bones_stride)
+    {
+        std::vector<uint8_t> welded(kept.size() * bones_stride);
+        for (size_t v = 0; v < kept.size(); v++)
+            std::memcpy(&welded[v * bones_stride], &mesh.bones_indices[kept[v] * bones_stride], bones_stride);
+
+        mesh.bones_indices = std::move(welded);
+    }
+
+    mesh.vertices_count = kept.size();
+    mesh.statistics.vertices_after = kept.size();
+    return true;
+}
+
+//Finds a float attribute of a mesh in the default form. Streams follow the attribute order and hold
+//either every float attribute interleaved or one attribute each.
+bool find_mesh_attrib(const model::mesh& mesh, model::attribute attrib, const float*& data, size_t& stride)
+{
+    if (!mesh.attributes.count(attrib) || !is_float_attribute(attrib) || mesh.vertices.empty() || !mesh.vertices_count)
+        return false;
+
+    size_t float_attributes = 0;
+    for (auto a : mesh.attributes)
+        float_attributes += is_float_attribute(a);
+
+    const bool interleaved = mesh.vertices.size() == 1;
+    if (!interleaved && mesh.vertices.size() != float_attributes)
+        return false;
+
+    auto stream = mesh.vertices.begin();
+    size_t offset = 0;
+
+    //bones_weights, the only attribute of a variable size, comes last
+    for (auto a : mesh.attributes)
+    {
+        if (!is_float_attribute(a))
+            continue;
+
+        if (a == attrib)
+        {
+            data = stream->data() + offset;
+            stride = stream->size() / mesh.vertices_count;
+            return true;
+        }
+
+        if (interleaved)
+            offset += a == model::attribute::texcoord ? 2 : a == model::attribute::tangents_bitangents ? 6 : 3;
+        else
+            stream++;
+    }
+
+    return false;
+}
+
+//Level of detail generation
+//Edges are collapsed in passes, cheapest first by the quadric error of moving a vertex onto its neighbour.
+//Vertices only ever move onto other vertices, so every level indexes the vertices of the mesh. Exact
+//duplicates of a vertex are simplified as one vertex. Vertices on borders and on attribute seams, where
+//vertices share a position but not the rest, stay in place, and a vertex only collapses onto neighbours
+//with nearly the same bone influences.
+
+//Symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww, summed over planes
+struct quadric
+{
+    double m[10] = {};
+    double planes = 0;
+
+    void add_plane(double a, double b, double c, double d)
+    {
+        const double p[4] = {a, b, c, d};
+        size_t k = 0;
+        for (size_t i = 0; i < 4; i++)
+            for (size_t j = i; j < 4; j++)
+                m[k++] += p[i] * p[j];
+        planes++;
+    }
+
+    void add(const quadric& other)
+    {
+        for (size_t i = 0; i < 10; i++)
+            m[i] += other.m[i];
+        planes += other.planes;
+    }
+
+    double error(const float* p) const
+    {
+        const double x = p[0], y = p[1], z = p[2];
+        return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+            + m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+            + m[7] * z * z + 2 * m[8] * z
+            + m[9];
+    }
+};
+
+std::array<float, 3> triangle_normal(const float* a, const float* b, const float* c)
+{
+    const float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    return {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]};
+}
+
+//Bone influences of the vertices, compared by the sum of the weight differences, from 0 to 2
+struct skinning_view
+{
+    const float*    weights = nullptr;
+    size_t          weights_stride = 0;
+    const uint8_t*  ids = nullptr;
+    size_t          slots = 0;
+    size_t          id_size = 0;
+
+    unsigned int id(size_t v, size_t s) const
+    {
+        unsigned int output = 0;
+        std::memcpy(&output, ids + (v * slots + s) * id_size, id_size);
+        return output;
+    }
+
+    float weight(size_t v, unsigned int bone) const
+    {
+        float output = 0;
+        for (size_t s = 0; s < slots; s++)
+            if (id(v, s) == bone)
+                output += weights[v * weights_stride + s];
+        return output;
+    }
+
+    float difference(size_t a, size_t b) const
+    {
+        float output = 0;
+        for (size_t s = 0; s < slots; s++)
+        {
+            if (weights[a * weights_stride + s] > 0)
+                output += std::abs(weight(a, id(a, s)) - weight(b, id(a, s)));
+
+            //Bones influencing only b
+            if (weights[b * weights_stride + s] > 0 && weight(a, id(b, s)) == 0)
+                output += weights[b * weights_stride + s];
+        }
+        return output;
+    }
+};
+
+constexpr float lod_max_skinning_difference = 0.25f;
+
+//Keeps collapsing until the triangles are down to target or no collapse is left. Returns the largest
+//mean squared distance to the planes of a collapse, ordering is by the summed cost.
+double simplify_indicies(
+    std::vector<unsigned int>&      indicies,
+    size_t                          target,
+    const float*                    positions,
+    size_t                          stride,
+    size_t                          vertices_count,
+    std::vector<quadric>&           quadrics,
+    const std::vector<bool>&        locked,
+    const skinning_view&            skinning
+)
+{
+    struct collapse
+    {
+        unsigned int    from;
+        unsigned int    to;
+        double          cost;
+        double          distance;
+    };
+
+    auto position = [&](unsigned int v){ return positions + v * stride; };
+
+    double max_distance = 0;
+    std::vector<collapse> collapses;
+    std::vector<unsigned int> remap(vertices_count);
+    std::vector<bool> used(vertices_count);
+    std::vector<unsigned int> adjacency_offsets(vertices_count + 1);
+    std::vector<unsigned int> adjacency;
+
+    while (indicies.size() / 3 > target)
+    {
+        const size_t triangles_count = indicies.size() / 3;
+
+        //Candidates, both directions of every edge
+
+        collapses.clear();
+        for (size_t t = 0; t < triangles_count; t++)
+            for (size_t k = 0; k < 3; k++)
+            {
+                const unsigned int a = indicies[t * 3 + k], b = indicies[t * 3 + (k + 1) % 3];
+
+                for (auto [from, to] : {std::make_pair(a, b), std::make_pair(b, a)})
+                {
+                    if (locked[from] || (skinning.weights && skinning.difference(from, to) > lod_max_skinning_difference))
+                        continue;
+
+                    quadric q = quadrics[from];
+                    q.add(quadrics[to]);
+
+                    const double cost = std::max(q.error(position(to)), 0.0);
+                    collapses.push_back({from, to, cost, q.planes > 0 ? cost / q.planes : 0});
+                }
+            }
+
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const collapse& l, const collapse& r){
+            return l.cost < r.cost || (l.cost == r.cost && (l.from < r.from || (l.from == r.from && l.to < r.to)));
+        });
+
+        //Vertex to triangles adjacency
+
+        std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+        for (auto index : indicies)
+            adjacency_offsets[index + 1]++;
+        for (size_t v = 0; v < vertices_count; v++)
+            adjacency_offsets[v + 1] += adjacency_offsets[v];
+
+        adjacency.resize(indicies.size());
+        {
+            std::vector<unsigned int> filled(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+            for (size_t t = 0; t < triangles_count; t++)
+                for (size_t k = 0; k < 3; k++)
+                    adjacency[filled[indicies[t * 3 + k]]++] = (unsigned int)t;
+        }
+
+        //Collapses in a pass touch disjoint triangles, so each one is checked against the mesh as it is
+
+        for (size_t v = 0; v < vertices_count; v++)
+            remap[v] = (unsigned int)v;
+        std::fill(used.begin(), used.end(), false);
+
+        size_t removed = 0;
+        for (auto& c : collapses)
+        {
+            if (used[c.from] || used[c.to])
+                continue;
+
+            //Triangles around from must not flip, those with to in them disappear
+            bool valid = true;
+            size_t disappearing = 0;
+
+            for (size_t i = adjacency_offsets[c.from]; i < adjacency_offsets[c.from + 1] && valid; i++)
+            {
+                const unsigned int* triangle = &indicies[adjacency[i] * 3];
+                if (triangle[0] == c.to || triangle[1] == c.to || triangle[2] == c.to)
+                {
+                    disappearing++;
+                    continue;
+                }
+
+                const float* corners[3];
+                const float* moved[3];
+                for (size_t k = 0; k < 3; k++)
+                {
+                    corners[k] = position(triangle[k]);
+                    moved[k] = triangle[k] == c.from ? position(c.to) : corners[k];
+                }
+
+                //Turning by more than about 75 degrees counts as a flip
+                const auto before = triangle_normal(corners[0], corners[1], corners[2]);
+                const auto after = triangle_normal(moved[0], moved[1], moved[2]);
+                const float dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                const float lengths = (before[0] * before[0] + before[1] * before[1] + before[2] * before[2])
+                    * (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+                valid = dot > 0 && dot * dot > 0.0625f * lengths;
+            }
+
+            if (!valid)
+                continue;
+
+            remap[c.from] = c.to;
+            for (size_t i = adjacency_offsets[c.from]; i < adjacency_offsets[c.from + 1]; i++)
+                for (size_t k = 0; k < 3; k++)
+                    used[indicies[adjacency[i] * 3 + k]] = true;
+
+            quadrics[c.to].add(quadrics[c.from]);
+            max_distance = std::max(max_distance, c.distance);
+
+            removed += disappearing;
+            if (triangles_count - removed <= target)
+                break;
+        }
+
+        if (!removed)
+            break;
+
+        //Rewrite, dropping the triangles that collapsed into edges
+
+        size_t kept = 0;
+        for (size_t t = 0; t < triangles_count; t++)
+        {
+            const unsigned int a = remap[indicies[t * 3]], b = remap[indicies[t * 3 + 1]], c = remap[indicies[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+
+            indicies[kept++] = a;
+            indicies[kept++] = b;
+            indicies[kept++] = c;
+        }
+        indicies.resize(kept);
+    }
+
+    return max_distance;
+}
+
+bool gll::generate_lods(model::mesh& mesh, const std::vector<float>& ratios)
+{
+    const float* positions;
+    size_t stride;
+
+    if (!is_processable_mesh(mesh) || !find_mesh_attrib(mesh, model::attribute::position, positions, stride))
+        return false;
+
+    const size_t vertices_count = mesh.vertices_count;
+    const size_t triangles_count = mesh.indicies.size() / 3;
+    mesh.lods.clear();
+
+    auto position = [&](unsigned int v){ return positions + v * stride; };
+
+    //Vertices sharing a position form a group. Those equal in every attribute are exact duplicates and
+    //are replaced by the first of them, the group is a seam if anything else is left in it.
+
+    std::vector<bool> locked(vertices_count, false);
+    std::vector<unsigned int> group(vertices_count);
+    std::vector<unsigned int> canonical(vertices_count);
+    {
+        const size_t bones_stride = mesh.bones_indices.size() / vertices_count;
+
+        auto compare_attributes = [&](unsigned int l, unsigned int r){
+            for (auto& stream : mesh.vertices)
+            {
+                const size_t floats = stream.size() / vertices_count;
+                if (int c = std::memcmp(&stream[l * floats], &stream[r * floats], floats * sizeof(float)))
+                    return c;
+            }
+            return bones_stride ? std::memcmp(&mesh.bones_indices[l * bones_stride], &mesh.bones_indices[r * bones_stride], bones_stride) : 0;
+        };
+
+        std::vector<unsigned int> order(vertices_count);
+        for (size_t v = 0; v < vertices_count; v++)
+            order[v] = (unsigned int)v;
+
+        std::sort(order.begin(), order.end(), [&](unsigned int l, unsigned int r){
+            const int c = std::memcmp(position(l), position(r), 3 * sizeof(float));
+            if (c)
+                return c < 0;
+            const int a = compare_attributes(l, r);
+            return a ? a < 0 : l < r;
+        });
+
+        for (size_t i = 0; i < vertices_count; )
+        {
+            size_t j = i + 1;
+            while (j < vertices_count && !std::memcmp(position(order[i]), position(order[j]), 3 * sizeof(float)))
+                j++;
+
+            bool seam = false;
+            for (size_t k = i; k < j; k++)
+            {
+                group[order[k]] = order[i];
+                canonical[order[k]] = k > i && !compare_attributes(order[k - 1], order[k]) ? canonical[order[k - 1]] : order[k];
+                seam |= canonical[order[k]] != order[i];
+            }
+
+            for (size_t k = i; k < j; k++)
+                locked[order[k]] = seam;
+            i = j;
+        }
+    }
+
+    //Triangles over the first duplicates, those left without an area are dropped
+
+    std::vector<unsigned int> indicies;
+    indicies.reserve(mesh.indicies.size());
+    for (size_t t = 0; t < triangles_count; t++)
+    {
+        const unsigned int a = canonical[mesh.indicies[t * 3]], b = canonical[mesh.indicies[t * 3 + 1]], c = canonical[mesh.indicies[t * 3 + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+
+        indicies.push_back(a);
+        indicies.push_back(b);
+        indicies.push_back(c);
+    }
+
+    //Plane quadrics of the triangles around every vertex
+
+    std::vector<quadric> quadrics(vertices_count);
+    for (size_t t = 0; t < indicies.size() / 3; t++)
+    {
+        const unsigned int* triangle = &indicies[t * 3];
+        const auto n = triangle_normal(position(triangle[0]), position(triangle[1]), position(triangle[2]));
+        const double length = std::sqrt((double)n[0] * n[0] + (double)n[1] * n[1] + (double)n[2] * n[2]);
+        if (length == 0)
+            continue;
+
+        const double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+        const float* p = position(triangle[0]);
+        const double d = -(a * p[0] + b * p[1] + c * p[2]);
+
+        for (size_t k = 0; k < 3; k++)
+            quadrics[triangle[k]].add_plane(a, b, c, d);
+    }
+
+    //Edges of a single triangle are borders
+
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    edges.reserve(indicies.size());
+    for (size_t t = 0; t < indicies.size() / 3; t++)
+        for (size_t k = 0; k < 3; k++)
+        {
+            unsigned int a = group[indicies[t * 3 + k]], b = group[indicies[t * 3 + (k + 1) % 3]];
+            edges.push_back({std::min(a, b), std::max(a, b)});
+        }
+
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size(); )
+    {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i])
+            j++;
+
+        if (j - i != 2)
+        {
+            locked[edges[i].first] = true;
+            locked[edges[i].second] = true;
+        }
+        i = j;
+    }
+
+    //Group representatives stand for every vertex of their position
+    for (size_t v = 0; v < vertices_count; v++)
+        if (locked[group[v]])
+            locked[v] = true;
+
+    //Skinning
+
+    skinning_view skinning;
+    size_t weights_stride;
+    if (!mesh.bones_indices.empty() && find_mesh_attrib(mesh, model::attribute::bones_weights, skinning.weights, weights_stride))
+    {
+        skinning.weights_stride = weights_stride;
+        skinning.id_size = component_size(mesh.bones_indices_type);
+        skinning.slots = mesh.bones_indices.size() / vertices_count / skinning.id_size;
+        skinning.ids = mesh.bones_indices.data();
+
+        if (skinning.slots > weights_stride)
+            skinning.weights = nullptr;
+    }
+
+    //Every level continues from the previous one
+
+    float extent = 0;
+    {
+        float low[3] = {INFINITY, INFINITY, INFINITY}, high[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for (size_t v = 0; v < vertices_count; v++)
+            for (size_t k = 0; k < 3; k++)
+            {
+                low[k] = std::min(low[k], position((unsigned int)v)[k]);
+                high[k] = std::max(high[k], position((unsigned int)v)[k]);
+            }
+
+        for (size_t k = 0; k < 3 && vertices_count; k++)
+            extent += (high[k] - low[k]) * (high[k] - low[k]);
+        extent = std::sqrt(extent);
+    }
+
+    double error = 0;
+
+    for (auto ratio : ratios)
+    {
+        const size_t target = (size_t)(std::clamp(ratio, 0.0f, 1.0f) * triangles_count);
+        error = std::max(error, simplify_indicies(indicies, target, positions, stride, vertices_count, quadrics, locked, skinning));
+
+        model::mesh::lod level;
+        level.ratio = triangles_count ? (float)(indicies.size() / 3) / triangles_count : 1.0f;
+        level.error = extent > 0 ? (float)(std::sqrt(error) / extent) : 0.0f;
+        level.indicies = indicies;
+        mesh.lods.push_back(std::move(level));
+    }
+
+    return true;
+}
+
+//Meshlets
+//A meshlet starts at the first triangle not taken yet and grows by the neighbouring triangle adding
+//the fewest new vertices, the one closest to its center among equals, until a limit is reached or no
+//neighbour fits any more.
+
+void compute_meshlet_bounds(
+    model::mesh::meshlet&       meshlet,
+    const model::mesh&          mesh,
+    const float*                positions,
+    size_t                      stride
+)
+{
+    const unsigned int* vertices = &mesh.meshlet_vertices[meshlet.vertex_offset];
+    const uint8_t* triangles = &mesh.meshlet_triangles[meshlet.triangle_offset];
+    auto position = [&](size_t local){ return positions + vertices[local] * stride; };
+
+    //Sphere around the bounding box center
+
+    float low[3] = {INFINITY, INFINITY, INFINITY}, high[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t v = 0; v < meshlet.vertex_count; v++)
+        for (size_t k = 0; k < 3; k++)
+        {
+            low[k] = std::min(low[k], position(v)[k]);
+            high[k] = std::max(high[k], position(v)[k]);
+        }
+
+    float radius = 0;
+    for (size_t k = 0; k < 3; k++)
+        meshlet.center[k] = (low[k] + high[k]) * 0.5f;
+
+    for (size_t v = 0; v < meshlet.vertex_count; v++)
+    {
+        const float* p = position(v);
+        const float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+        radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+    }
+    meshlet.radius = std::sqrt(radius);
+
+    //Cone around the average of the triangle normals
+
+    std::vector<std::array<float, 3>> normals, corners;
+    float axis[3] = {0, 0, 0};
+
+    for (size_t t = 0; t < meshlet.triangle_count; t++)
+    {
+        auto n = triangle_normal(position(triangles[t * 3]), position(triangles[t * 3 + 1]), position(triangles[t * 3 + 2]));
+        const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0)
+            continue;
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            n[k] /= length;
+            axis[k] += n[k];
+        }
+        normals.push_back(n);
+
+        const float* corner = position(triangles[t * 3]);
+        corners.push_back({corner[0], corner[1], corner[2]});
+    }
+
+    const float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float min_dot = 1;
+
+    for (size_t k = 0; k < 3; k++)
+        meshlet.cone_axis[k] = axis_length > 0 ? axis[k] / axis_length : 0;
+
+    for (auto& n : normals)
+        min_dot = std::min(min_dot, n[0] * meshlet.cone_axis[0] + n[1] * meshlet.cone_axis[1] + n[2] * meshlet.cone_axis[2]);
+
+    meshlet.cone_cutoff = axis_length > 0 && min_dot > 0 ? std::sqrt(1 - min_dot * min_dot) : 1.0f;
+
+    //The apex lies back along the axis from the center, far enough to be behind every triangle plane.
+    //A camera within the cone from there sees only the backs of the triangles.
+
+    float apex_distance = 0;
+    if (meshlet.cone_cutoff < 1)
+        for (size_t i = 0; i < normals.size(); i++)
+        {
+            const auto& normal = normals[i];
+            const auto& a = corners[i];
+            const float plane = (a[0] - meshlet.center[0]) * normal[0] + (a[1] - meshlet.center[1]) * normal[1] + (a[2] - meshlet.center[2]) * normal[2];
+            const float along = meshlet.cone_axis[0] * normal[0] + meshlet.cone_axis[1] * normal[1] + meshlet.cone_axis[2] * normal[2];
+            apex_distance = std::max(apex_distance, -plane / along);
+        }
+
+    for (size_t k = 0; k < 3; k++)
+        meshlet.cone_apex[k] = meshlet.center[k] - meshlet.cone_axis[k] * apex_distance;
+}
+
+bool gll::build_meshlets(model::mesh& mesh, size_t max_vertices, size_t max_triangles)
+{
+    const float* positions;
+    size_t stride;
+
+    if (!is_processable_mesh(mesh) || !find_mesh_attrib(mesh, model::attribute::position, positions, stride)
+        || max_vertices < 3 || max_vertices > 256 || max_triangles < 1)
+        return false;
+
+    mesh.meshlets.clear();
+    mesh.meshlet_vertices.clear();
+    mesh.meshlet_triangles.clear();
+
+    const size_t vertices_count = mesh.vertices_count;
+    const size_t triangles_count = mesh.indicies.size() / 3;
+    const unsigned int* indicies = mesh.indicies.data();
+
+    //Vertex to triangles adjacency and triangle centroids
+
+    std::vector<unsigned int> adjacency_offsets(vertices_count + 1, 0);
+    for (auto index : mesh.indicies)
+        adjacency_offsets[index + 1]++;
+    for (size_t v = 0; v < vertices_count; v++)
+        adjacency_offsets[v + 1] += adjacency_offsets[v];
+
+    std::vector<unsigned int> adjacency(mesh.indicies.size());
+    {
+        std::vector<unsigned int> filled(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (size_t t = 0; t < triangles_count; t++)
+            for (size_t k = 0; k < 3; k++)
+                adjacency[filled[indicies[t * 3 + k]]++] = (unsigned int)t;
+    }
+
+    std::vector<std::array<float, 3>> centroids(triangles_count);
+    for (size_t t = 0; t < triangles_count; t++)
+        for (size_t k = 0; k < 3; k++)
+            centroids[t][k] = (positions[indicies[t * 3] * stride + k] + positions[indicies[t * 3 + 1] * stride + k] + positions[indicies[t * 3 + 2] * stride + k]) / 3;
+
+    //Growth
+
+    std::vector<bool> taken(triangles_count, false);
+    std::vector<int> local(vertices_count, -1);
+    std::vector<unsigned int> candidates;
+    size_t seed = 0;
+
+    while (true)
+    {
+        while (seed < triangles_count && taken[seed])
+            seed++;
+
+        if (seed == triangles_count)
+            break;
+
+        model::mesh::meshlet meshlet{};
+        meshlet.vertex_offset = (uint32_t)mesh.meshlet_vertices.size();
+        meshlet.triangle_offset = (uint32_t)mesh.meshlet_triangles.size();
+
+        float center[3] = {0, 0, 0};
+
+        auto add = [&](unsigned int t){
+            taken[t] = true;
+
+            for (size_t k = 0; k < 3; k++)
+            {
+                const unsigned int v = indicies[t * 3 + k];
+                if (local[v] < 0)
+                {
+                    local[v] = (int)meshlet.vertex_count++;
+                    mesh.meshlet_vertices.push_back(v);
+
+                    for (size_t i = adjacency_offsets[v]; i < adjacency_offsets[v + 1]; i++)
+                        if (!taken[adjacency[i]])
+                            candidates.push_back(adjacency[i]);
+                }
+
+                mesh.meshlet_triangles.push_back((uint8_t)local[v]);
+            }
+
+            for (size_t k = 0; k < 3; k++)
+                center[k] += centroids[t][k];
+
+            meshlet.triangle_count++;
+        };
+
+        add((unsigned int)seed);
+
+        while (meshlet.triangle_count < max_triangles)
+        {
+            unsigned int best = ~0u;
+            size_t best_new = 4;
+            float best_distance = INFINITY;
+
+            for (size_t i = 0; i < candidates.size(); )
+            {
+                const unsigned int t = candidates[i];
+                if (taken[t])
+                {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                i++;
+
+                size_t added = 0;
+                for (size_t k = 0; k < 3; k++)
+                    added += local[indicies[t * 3 + k]] < 0;
+
+                if (meshlet.vertex_count + added > max_vertices || added > best_new)
+                    continue;
+
+                float distance = 0;
+                for (size_t k = 0; k < 3; k++)
+                {
+                    const float d = centroids[t][k] - center[k] / meshlet.triangle_count;
+                    distance += d * d;
+                }
+
+                if (added < best_new || distance < best_distance)
+                {
+                    best = t;
+                    best_new = added;
+                    best_distance = distance;
+                }
+            }
+
+            if (best == ~0u)
+                break;
+
+            add(best);
+        }
+
+        for (size_t v = 0; v < meshlet.vertex_count; v++)
+            local[mesh.meshlet_vertices[meshlet.vertex_offset + v]] = -1;
+        candidates.clear();
+
+        compute_meshlet_bounds(meshlet, mesh, positions, stride);
+        mesh.meshlets.push_back(meshlet);
+    }
+
+    return true;
+}
+
+//Runs the optional processing passes requested by the settings
+void postprocess_mesh(
+    model::mesh&                mesh,
+    const model_load_settings&  settings
+)
+{
+    if (settings.weld_vertices)
+        weld_vertices(mesh, settings.weld_epsilon);
+
+    if (settings.optimize_vertex_cache)
+        optimize_vertex_cache(mesh, settings.vertex_cache_size);
+
+    if (!settings.lod_ratios.empty())
+        generate_lods(mesh, settings.lod_ratios);
+
+    if (settings.build_meshlets)
+        build_meshlets(mesh, settings.meshlet_max_vertices, settings.meshlet_max_triangles);
+}
+
+//Static batching
+//Node transforms are baked into the vertices of every mesh instance, and instances sharing a material,
+//attribute set and primitive types are merged into one batch. Skinned meshes are posed by their bones,
+//so they stay on their nodes, which are kept under the new root together with the bone nodes.
+
+using matrix4x4 = std::array<std::array<float, 4>, 4>;
+
+matrix4x4 multiply_matrices(const matrix4x4& a, const matrix4x4& b)
+{
+    matrix4x4 output;
+    for (size_t r = 0; r < 4; r++)
+        for (size_t c = 0; c < 4; c++)
+            output[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c] + a[r][3] * b[3][c];
+
+    return output;
+}
+
+//Cofactors of the upper 3x3 of m, that is its inverse transpose scaled by the determinant.
+//The sign of the determinant is divided out, so normals keep facing outwards in mirrored transforms.
+matrix4x4 normal_matrix(const matrix4x4& m)
+{
+    matrix4x4 output{};
+
+    output[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    output[0][1] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    output[0][2] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    output[1][0] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+    output[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+    output[1][2] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+    output[2][0] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+    output[2][1] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+    output[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+    const float determinant = m[0][0] * output[0][0] + m[0][1] * output[0][1] + m[0][2] * output[0][2];
+    if (determinant < 0)
+        for (size_t r = 0; r < 3; r++)
+            for (size_t c = 0; c < 3; c++)
+                output[r][c] = -output[r][c];
+
+    return output;
+}
+
+bool is_mirroring(const matrix4x4& m)
+{
+    const float determinant =
+        m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+        m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+        m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+    return determinant < 0;
+}
+
+//Transforms count vec3s placed every stride floats, in place. Points take the full affine transform,
+//directions only the upper 3x3 and are renormalized afterwards.
+void transform_vec3(float* data, size_t stride, size_t count, const matrix4x4& m, bool point)
+{
+    auto transform_one = [&](float* v){
+        float x = v[0], y = v[1], z = v[2];
+
+        float tx = m[0][0] * x + m[0][1] * y + m[0][2] * z;
+        float ty = m[1][0] * x + m[1][1] * y + m[1][2] * z;
+        float tz = m[2][0] * x + m[2][1] * y + m[2][2] * z;
+
+        if (point)
+        {
+            tx += m[0][3]; ty += m[1][3]; tz += m[2][3];
+        }
+        else
+        {
+            float length = std::sqrt(tx * tx + ty * ty + tz * tz);
+            if (length > 0)
+            {
+                tx /= length; ty /= length; tz /= length;
+            }
+        }
+
+        v[0] = tx; v[1] = ty; v[2] = tz;
+    };
+
+    size_t i = 0;
+
+#if defined(GLL_SSE2)
+    //4 vertices per iteration, gathered into x, y and z registers
+    __m128 rows[3][4];
+    for (size_t r = 0; r < 3; r++)
+        for (size_t c = 0; c < 4; c++)
+            rows[r][c] = _mm_set1_ps(m[r][c]);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        float* v[4] = {data + i * stride, data + (i + 1) * stride, data + (i + 2) * stride, data + (i + 3) * stride};
+
+        __m128 x = _mm_setr_ps(v[0][0], v[1][0], v[2][0], v[3][0]);
+        __m128 y = _mm_setr_ps(v[0][1], v[1][1], v[2][1], v[3][1]);
+        __m128 z = _mm_setr_ps(v[0][2], v[1][2], v[2][2], v[3][2]);
+
+        __m128 t[3];
+        for (size_t r = 0; r < 3; r++)
+        {
+            t[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rows[r][0], x), _mm_mul_ps(rows[r][1], y)), _mm_mul_ps(rows[r][2], z));
+            if (point)
+                t[r] = _mm_add_ps(t[r], rows[r][3]);
+        }
+
+        if (!point)
+        {
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(t[0], t[0]), _mm_mul_ps(t[1], t[1])), _mm_mul_ps(t[2], t[2])));
+            __m128 nonzero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+            __m128 scale = _mm_or_ps(_mm_and_ps(nonzero, _mm_div_ps(_mm_set1_ps(1.0f), length)), _mm_andnot_ps(nonzero, _mm_set1_ps(1.0f)));
+
+            for (size_t r = 0; r < 3; r++)
+                t[r] = _mm_mul_ps(t[r], scale);
+        }
+
+        alignas(16) float out[3][4];
+        for (size_t r = 0; r < 3; r++)
+            _mm_store_ps(out[r], t[r]);
+
+        for (size_t k = 0; k < 4; k++)
+        {
+            v[k][0] = out[0][k];
+            v[k][1] = out[1][k];
+            v[k][2] = out[2][k];
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+        transform_one(data + i * stride);
+}
+
+//Where an attribute lives in the vertex streams of a mesh in the default form, in floats
+struct vertex_attrib_location
+{
+    size_t  stream;
+    size_t  offset;
+    size_t  stride;
+};
+
+bool locate_vertex_attrib(
+    vertex_attrib_location&             output,
+    const std::set<model::attribute>&   attributes,
+    model::attribute                    attrib,
+    const model_load_settings&          settings
+)
+{
+    size_t vertex_length = 0;
+    for (auto& a : attributes)
+        if (is_float_attribute(a))
+            vertex_length += attribute_components(a, settings);
+
+    size_t stream = 0, offset = 0;
+    for (auto& a : attributes)
+    {
+        if (!is_float_attribute(a))
+            continue;
+
+        const size_t components = attribute_components(a, settings);
+
+        if (a == attrib)
+        {
+            output = {stream, offset, settings.interleave_attributes ? vertex_length : components};
+            return true;
+        }
+
+        if (settings.interleave_attributes)
+            offset += components;
+        else
+            stream++;
+    }
+
+    return false;
+}
+
+struct static_batch
+{
+    struct instance
+    {
+        unsigned int    mesh;
+        matrix4x4       transform;
+    };
+
+    int                         material_id;
+    std::set<model::attribute>  attributes;
+    unsigned int                primitive_types;
+    std::vector<instance>       instances;
+};
+
+void build_static_batch(
+    model::mesh&                        output,
+    const std::vector<model::mesh>&     meshes,
+    const static_batch&                 batch,
+    const model_load_settings&          settings
+)
+{
+    output.attributes = batch.attributes;
+    output.material_id = batch.material_id;
+    output.primitives = convert_assimp_primitive_types(batch.primitive_types);
+
+    //Allocate
+
+    size_t vertices_count = 0, indicies_count = 0;
+    for (auto& instance : batch.instances)
+    {
+        vertices_count += meshes[instance.mesh].vertices_count;
+        indicies_count += meshes[instance.mesh].indicies.size();
+    }
+
+    std::vector<size_t> strides(meshes[batch.instances[0].mesh].vertices.size(), 0);
+    output.vertices.resize(strides.size());
+
+    for (auto& attrib : batch.attributes)
+    {
+        vertex_attrib_location location;
+        locate_vertex_attrib(location, batch.attributes, attrib, settings);
+        strides[location.stream] = location.stride;
+    }
+
+    auto stride = strides.begin();
+    for (auto& stream : output.vertices)
+        stream.resize(vertices_count * *stride++);
+
+    output.vertices_count = vertices_count;
+    output.indicies.resize(indicies_count);
+
+    //Copy and transform every instance
+
+    std::vector<float*> streams;
+    for (auto& stream : output.vertices)
+        streams.push_back(stream.data());
+
+    const bool triangles = batch.primitive_types == aiPrimitiveType_TRIANGLE;
+    size_t first_vertex = 0, first_index = 0;
+
+    for (auto& instance : batch.instances)
+    {
+        const model::mesh& mesh = meshes[instance.mesh];
+
+        size_t s = 0;
+        for (auto& stream : mesh.vertices)
+        {
+            std::memcpy(streams[s] + first_vertex * strides[s], stream.data(), stream.size() * sizeof(float));
+            s++;
+        }
+
+        auto transform = [&](model::attribute attrib, size_t offset, const matrix4x4& m, bool point){
+            vertex_attrib_location location;
+            if (locate_vertex_attrib(location, batch.attributes, attrib, settings))
+                transform_vec3(streams[location.stream] + first_vertex * location.stride + location.offset + offset, location.stride, mesh.vertices_count, m, point);
+        };
+
+        const matrix4x4 normals = normal_matrix(instance.transform);
+        transform(model::attribute::position,               0,  instance.transform, true);
+        transform(model::attribute::normal,                 0,  normals,            false);
+        transform(model::attribute::tangents_bitangents,    0,  instance.transform, false);
+        transform(model::attribute::tangents_bitangents,    3,  instance.transform, false);
+
+        unsigned int* target = output.indicies.data() + first_index;
+        for (auto index : mesh.indicies)
+            *target++ = index + (unsigned int)first_vertex;
+
+        //Mirroring turns the triangles inside out, restore their winding
+        if (triangles && is_mirroring(instance.transform))
+            for (size_t i = first_index; i + 2 < first_index + mesh.indicies.size(); i += 3)
+                std::swap(output.indicies[i + 1], output.indicies[i + 2]);
+
+        first_vertex += mesh.vertices_count;
+        first_index += mesh.indicies.size();
+    }
+
+    vertex_attrib_location location;
+    if (locate_vertex_attrib(location, batch.attributes, model::attribute::position, settings))
+        compute_bounding_volume(output.bounds, streams[location.stream] + location.offset, location.stride, vertices_count);
+}
+
+//Replaces the meshes and nodes of the model with the batches and a root node referencing them. Nodes of
+//skinned meshes and bones are kept below the root with their ancestors. primitive_types holds the aiPrimitiveType flags of every mesh and is updated alongside the meshes.
+void flatten_static_batches(
+    model&                          mod,
+    std::vector<unsigned int>&      primitive_types,
+    const model_load_settings&      settings
+)
+{
+    std::vector<static_batch>   batches;
+    std::vector<unsigned int>   skinned;
+    std::vector<bool>           kept(mod.meshes.size(), false);
+    std::vector<bool>           kept_nodes(mod.nodes.size(), false);
+    std::vector<matrix4x4>      world(mod.nodes.size());
+
+    //Nodes come after their parents, so their world transforms resolve in order
+    for (size_t n = 0; n < mod.nodes.size(); n++)
+    {
+        const auto& node = mod.nodes[n];
+        world[n] = node.parent < 0 ? node.transform : multiply_matrices(world[node.parent], node.transform);
+
+        if (mod.bones.count(node.name))
+            kept_nodes[n] = true;
+
+        for (auto m : node.meshes)
+        {
+            const model::mesh& mesh = mod.meshes[m];
+
+            if (mesh.attributes.count(model::attribute::bones_indices) || mesh.attributes.count(model::attribute::bones_weights))
+            {
+                if (!kept[m])
+                    skinned.push_back(m);
+                kept[m] = true;
+                kept_nodes[n] = true;
+                continue;
+            }
+
+            auto batch = std::find_if(batches.begin(), batches.end(), [&](const static_batch& b){
+                return b.material_id == mesh.material_id
+                    && b.attributes == mesh.attributes
+                    && b.primitive_types == primitive_types[m];
+            });
+
+            if (batch == batches.end())
+                batch = batches.insert(batches.end(), {mesh.material_id, mesh.attributes, primitive_types[m], {}});
+
+            batch->instances.push_back({m, world[n]});
+        }
+    }
+
+    std::vector<model::mesh> output(batches.size());
+    std::vector<unsigned int> output_primitive_types(batches.size());
+
+    parallel_for(batches.size(), settings.worker_threads, [&](size_t b){
+        build_static_batch(output[b], mod.meshes, batches[b], settings);
+        output_primitive_types[b] = batches[b].primitive_types;
+    });
+
+    std::vector<unsigned int> skinned_index(mod.meshes.size());
+    for (auto m : skinned)
+    {
+        skinned_index[m] = (unsigned int)output.size();
+        output.push_back(std::move(mod.meshes[m]));
+        output_primitive_types.push_back(primitive_types[m]);
+    }
+
+    //Children come after their parents, so walking backwards keeps every ancestor of a kept node
+    for (size_t n = mod.nodes.size(); n-- > 0;)
+        if (kept_nodes[n] && mod.nodes[n].parent >= 0)
+            kept_nodes[mod.nodes[n].parent] = true;
+
+    //A kept root keeps its name, bones are looked up by it
+    std::vector<model::node> nodes(1);
+    nodes[0] = {
+        mod.nodes.empty() || kept_nodes[0] ? std::string() : mod.nodes[0].name,
+        -1,
+        {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}}},
+        {}
+    };
+
+    for (unsigned int b = 0; b < batches.size(); b++)
+        nodes[0].meshes.push_back(b);
+
+    std::vector<int> node_index(mod.nodes.size(), -1);
+    for (size_t n = 0; n < mod.nodes.size(); n++)
+    {
+        if (!kept_nodes[n])
+            continue;
+
+        auto& node = mod.nodes[n];
+        model::node kept_node{std::move(node.name), node.parent < 0 ? 0 : node_index[node.parent], node.transform, {}};
+
+        for (auto m : node.meshes)
+            if (kept[m])
+                kept_node.meshes.push_back(skinned_index[m]);
+
+        node_index[n] = (int)nodes.size();
+        nodes.push_back(std::move(kept_node));
+    }
+
+    mod.meshes = std::move(output);
+    mod.nodes = std::move(nodes);
+    primitive_types = std::move(output_primitive_types);
+}
+
+//Bounds of the model as placed by its nodes. Boxes are transformed by their center and the absolute
+//matrix, spheres by their center and the largest axis scale.
+void aggregate_model_bounds(model& mod)
+{
+    mod.bounds = {};
+
+    std::vector<matrix4x4> world(mod.nodes.size());
+    std::vector<model::bounding_volume> placed;
+
+    for (size_t n = 0; n < mod.nodes.size(); n++)
+    {
+        const auto& node = mod.nodes[n];
+        const matrix4x4& m = world[n] = node.parent < 0 ? node.transform : multiply_matrices(world[node.parent], node.transform);
+
+        float scale = 0;
+        for (size_t j = 0; j < 3; j++)
+            scale = std::max(scale, m[0][j] * m[0][j] + m[1][j] * m[1][j] + m[2][j] * m[2][j]);
+        scale = std::sqrt(scale);
+
+        for (auto index : node.meshes)
+        {
+            if (index >= mod.meshes.size())
+                continue;
+
+            const model::mesh& mesh = mod.meshes[index];
+            if (!mesh.vertices_count || !mesh.attributes.count(model::attribute::position))
+                continue;
+
+            const auto& local = mesh.bounds;
+            model::bounding_volume bounds;
+
+            for (size_t i = 0; i < 3; i++)
+            {
+                float center = m[i][3], sphere_center = m[i][3], extent = 0;
+                for (size_t j = 0; j < 3; j++)
+                {
+                    center += m[i][j] * (local.min[j] + local.max[j]) * 0.5f;
+                    sphere_center += m[i][j] * local.center[j];
+                    extent += std::abs(m[i][j]) * (local.max[j] - local.min[j]) * 0.5f;
+                }
+
+                bounds.min[i] = center - extent;
+                bounds.max[i] = center + extent;
+                bounds.center[i] = sphere_center;
+            }
+            bounds.radius = local.radius * scale;
+
+            placed.push_back(bounds);
+        }
+    }
+
+    if (placed.empty())
+        return;
+
+    mod.bounds.min = placed[0].min;
+    mod.bounds.max = placed[0].max;
+    for (auto& bounds : placed)
+        for (size_t k = 0; k < 3; k++)
+        {
+            mod.bounds.min[k] = std::min(mod.bounds.min[k], bounds.min[k]);
+            mod.bounds.max[k] = std::max(mod.bounds.max[k], bounds.max[k]);
+        }
+
+    for (size_t k = 0; k < 3; k++)
+        mod.bounds.center[k] = (mod.bounds.min[k] + mod.bounds.max[k]) * 0.5f;
+
+    for (auto& bounds : placed)
+    {
+        const float dx = bounds.center[0] - mod.bounds.center[0];
+        const float dy = bounds.center[1] - mod.bounds.center[1];
+        const float dz = bounds.center[2] - mod.bounds.center[2];
+        mod.bounds.radius = std::max(mod.bounds.radius, std::sqrt(dx * dx + dy * dy + dz * dz) + bounds.radius);
+    }
+}
+
+//Serves the files of a model to Assimp from memory mappings
+class mapped_io_stream : public Assimp::IOStream
+{
+public:
+    mapped_io_stream(const mapped_file& file) : file(file) {}
+
+    ~mapped_io_stream() override { unmap_file(file); }
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+
+        size_t available = (file.size - position) / size;
+        if (count > available)
+            count = available;
+
+        std::memcpy(buffer, static_cast<const uint8_t*>(file.data) + position, size * count);
+        position += size * count;
+        return count;
+    }
+
+    size_t Write(const void*, size_t, size_t) override { return 0; }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t base = 0;
+        if (origin == aiOrigin_CUR) base = position;
+        if (origin == aiOrigin_END) base = file.size;
+
+        if (base + offset > file.size)
+            return aiReturn_FAILURE;
+
+        position = base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t      Tell() const override       { return position; }
+    size_t      FileSize() const override   { return file.size; }
+    void        Flush() override            {}
+
+private:
+    mapped_file file;
+    size_t      position = 0;
+};
+
+class mapped_io_system : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char* file) const override    { return system.Exists(file); }
+    char getOsSeparator() const override            { return system.getOsSeparator(); }
+
+    //Falls back to regular files for writes and files that cannot be mapped, like empty ones
+    Assimp::IOStream* Open(const char* file, const char* mode) override
+    {
+        mapped_file mapping;
+
+        if (std::strchr(mode, 'w') || !map_file(file, mapping))
+            return system.Open(file, mode);
+
+        return new mapped_io_stream(mapping);
+    }
+
+    void Close(Assimp::IOStream* file) override     { delete file; }
+
+private:
+    Assimp::DefaultIOSystem system;
+};
+
+//Counts the bytes Assimp reads from the files of a model
+class progress_io_stream : public Assimp::IOStream
+{
+public:
+    progress_io_stream(Assimp::IOStream* stream, load_progress* progress)
+        : stream(stream), progress(progress) {}
+
+    ~progress_io_stream() override { delete stream; }
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        size_t read = stream->Read(buffer, size, count);
+        progress->bytes_read += read * size;
+        return read;
+    }
+
+    size_t      Write(const void* buffer, size_t size, size_t count) override   { return stream->Write(buffer, size, count); }
+    aiReturn    Seek(size_t offset, aiOrigin origin) override                   { return stream->Seek(offset, origin); }
+    size_t      Tell() const override                                           { return stream->Tell(); }
+    size_t      FileSize() const override                                       { return stream->FileSize(); }
+    void        Flush() override                                                { stream->Flush(); }
+
+private:
+    Assimp::IOStream*   stream;
+    load_progress*      progress;
+};
+
+class progress_io_system : public Assimp::IOSystem
+{
+public:
+    progress_io_system(Assimp::IOSystem* system, load_progress* progress)
+        : system(system), progress(progress) {}
+
+    bool Exists(const char* file) const override    { return system->Exists(file); }
+    char getOsSeparator() const override            { return system->getOsSeparator(); }
+
+    Assimp::IOStream* Open(const char* file, const char* mode) override
+    {
+        Assimp::IOStream* stream = system->Open(file, mode);
+        return stream ? new progress_io_stream(stream, progress) : nullptr;
+    }
+
+    void Close(Assimp::IOStream* file) override     { delete file; }
+
+private:
+    std::unique_ptr<Assimp::IOSystem>   system;
+    load_progress*                      progress;
+};
+
+//Aborts the import once cancel is requested, never without progress
+class cancel_progress_handler : public Assimp::ProgressHandler
+{
+public:
+    cancel_progress_handler(load_progress* progress) : progress(progress) {}
+
+    bool Update(float) override { return !progress || !progress->cancel_requested; }
+
+private:
+    load_progress* progress;
+};
+
+//Gives a reused importer back its default state once an import is done with it.
+//Assimp leaks the replaced handler when reset with nullptr, so fresh ones are installed instead.
+struct importer_reset
+{
+    Assimp::Importer&   import;
+    bool                io_handler = false;
+    bool                progress_handler = false;
+
+    ~importer_reset()
+    {
+        import.FreeScene();
+
+        if (io_handler)         import.SetIOHandler(new Assimp::DefaultIOSystem());
+        if (progress_handler)   import.SetProgressHandler(new cancel_progress_handler(nullptr));
+    }
+};
+
+//Post processing steps requested by the settings
+unsigned int resolve_assimp_flags(const model_load_settings& settings)
+{
+    unsigned int flags = settings.postprocess_flags;
+
+    switch (settings.profile)
+    {
+    case pipeline_profile::standard:
+        flags |= aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+        break;
+    case pipeline_profile::fast_preview:
+        flags |= aiProcess_Triangulate | aiProcess_FlipUVs;
+        break;
+    case pipeline_profile::custom:
+        break;
+    }
+
+    if (settings.join_identical_vertices)   flags |= aiProcess_JoinIdenticalVertices;
+    if (settings.improve_cache_locality)    flags |= aiProcess_ImproveCacheLocality;
+    if (settings.sort_by_primitive_type)    flags |= aiProcess_SortByPType;
+
+    if (settings.tangents_on_demand && !settings.force_attributes.count(model::attribute::tangents_bitangents))
+        flags &= ~aiProcess_CalcTangentSpace;
+
+    return flags;
+}
+
+//Imports either the file at filepath or, when it is null, the memory block.
+//The importer is left without a scene and with its default handlers, ready for the next import.
+result<model> import_model(
+    Assimp::Importer&           import,
+    const char*                 filepath,
+    const void*                 memory,
+    size_t                      memory_size,
+    const char*                 format_hint,
+    const model_load_settings&  settings,
+    load_progress*              progress
+)
+{
+    model output;
+    importer_reset reset{import};
+
+    if (filepath && (settings.memory_map || progress))
+    {
+        Assimp::IOSystem* system = settings.memory_map
+            ? static_cast<Assimp::IOSystem*>(new mapped_io_system())
+            : static_cast<Assimp::IOSystem*>(new Assimp::DefaultIOSystem());
+
+        if (progress)
+            system = new progress_io_system(system, progress);
+
+        import.SetIOHandler(system);
+        reset.io_handler = true;
+    }
+
+    if (progress)
+    {
+        import.SetProgressHandler(new cancel_progress_handler(progress));
+        reset.progress_handler = true;
+    }
+
+    const unsigned int flags = resolve_assimp_flags(settings);
+
+    if (flags & aiProcess_ImproveCacheLocality)
+        import.SetPropertyInteger(AI_CONFIG_PP_ICL_PTCACHE_SIZE, (int)settings.vertex_cache_size);
+
+    const aiScene *scene = filepath
+        ? import.ReadFile(filepath, flags)
+        : import.ReadFileFromMemory(memory, memory_size, flags, format_hint ? format_hint : "");
+
+    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        return {false, {}};
+
+    std::vector<const aiMesh*> meshes(scene->mMeshes, scene->mMeshes + scene->mNumMeshes);
+    collect_assimp_nodes(output.nodes, scene->mRootNode, -1);
+    output.meshes.resize(meshes.size());
+    register_assimp_bones(output, meshes);
+
+    //Every bone id has to fit the bone indices type
+    const size_t bones_limit = settings.bones_indices_type == model::component_type::uint8 ? 256 : 65536;
+    if (settings.bones_indices_type == model::component_type::float32
+        || (settings.bones_indices_type != model::component_type::uint32 && output.bones.size() > bones_limit))
+        return {false, {}};
+
+    if (progress)
+        progress->meshes_total = meshes.size();
+
+    std::vector<unsigned int> primitive_types(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+        primitive_types[i] = meshes[i]->mPrimitiveTypes;
+
+    //The processing passes need triangle lists, which profiles without triangulation may not give
+    auto finish_mesh = [&](size_t i){
+        if (primitive_types[i] == aiPrimitiveType_TRIANGLE)
+            postprocess_mesh(output.meshes[i], settings);
+
+        finalize_mesh(output.meshes[i], settings);
+    };
+
+    const bool flatten = settings.flatten_static_batches;
+
+    parallel_for(meshes.size(), settings.worker_threads, [&](size_t i){
+        if (progress && progress->cancel_requested)
+            return;
+
+        process_assimp_mesh(output.meshes[i], output, settings, meshes[i]);
+
+        if (!flatten)
+            finish_mesh(i);
+
+        if (progress)
+            progress->meshes_converted++;
+    });
+
+    //Batches are processed once they are merged
+    if (flatten && !(progress && progress->cancel_requested))
+    {
+        flatten_static_batches(output, primitive_types, settings);
+        parallel_for(output.meshes.size(), settings.worker_threads, finish_mesh);
+    }
+
+    aggregate_model_bounds(output);
+
+    if (progress && progress->cancel_requested)
+    {
+        free_model(output);
+        return {false, {}};
+    }
+
+    return {true, std::move(output)};
+}
+
+//Cooked model cache
+//A cooked model holds a header followed by the bones and meshes. Contiguous mesh storage is used in
+//place in a copy on write mapping of the file. Vertex streams and indicies held in vectors are copied
+//out of it, as the vectors own their memory.
+
+constexpr char      cooked_model_magic[8]   = {'G', 'L', 'L', 'M', 'O', 'D', 'E', 'L'};
+constexpr uint32_t  cooked_model_version    = 8;
+
+//Every setting that changes the loaded model has to be hashed here
+uint64_t hash_model_load_settings(uint64_t hash, const model_load_settings& settings)
+{
+    hash = hash_value(hash, settings.interleave_attributes);
+    hash = hash_value(hash, settings.contiguous_storage);
+    hash = hash_value(hash, settings.compact_indicies);
+    hash = hash_value(hash, settings.max_influencial_bones);
+    hash = hash_value(hash, settings.bones_indices_type);
+
+    for (auto attrib : settings.force_attributes)
+        hash = hash_value(hash, attrib);
+
+    hash = hash_value(hash, settings.optimize_vertex_cache);
+    hash = hash_value(hash, settings.vertex_cache_size);
+    hash = hash_value(hash, settings.weld_vertices);
+    hash = hash_value(hash, settings.weld_epsilon);
+
+    for (auto ratio : settings.lod_ratios)
+        hash = hash_value(hash, ratio);
+
+    hash = hash_value(hash, settings.build_meshlets);
+    hash = hash_value(hash, settings.meshlet_max_vertices);
+    hash = hash_value(hash, settings.meshlet_max_triangles);
+    hash = hash_value(hash, resolve_assimp_flags(settings));
+    hash = hash_value(hash, settings.flatten_static_batches);
+    return hash;
+}
+
+void write_cooked_model(const std::string& path, uint64_t key, const model& mod)
+{
+    byte_writer writer;
+    writer.write(cooked_model_magic, sizeof(cooked_model_magic));
+    writer.write(cooked_model_version);
+    writer.write(key);
+
+    writer.write((uint64_t)mod.bones.size());
+    for (auto& [name, bone] : mod.bones)
+    {
+        writer.write((uint64_t)name.size());
+        writer.write(name.data(), name.size());
+        writer.write(bone.id);
+        writer.write(bone.offset_matrix_row_0);
+        writer.write(bone.offset_matrix_row_1);
+        writer.write(bone.offset_matrix_row_2);
+        writer.write(bone.offset_matrix_row_3);
+    }
+
+    writer.write((uint64_t)mod.meshes.size());
+    for (auto& mesh : mod.meshes)
+    {
+        writer.write((uint64_t)mesh.attributes.size());
+        for (auto attrib : mesh.attributes)
+            writer.write(attrib);
+
+        writer.write(mesh.material_id);
+        writer.write(mesh.primitives);
+        writer.write((uint64_t)mesh.vertices_count);
+        writer.write(mesh.statistics);
+        writer.write(mesh.bounds);
+        writer.write(mesh.indicies_type);
+
+        writer.write((uint64_t)mesh.vertices.size());
+        for (auto& stream : mesh.vertices)
+            writer.write_blob(stream.data(), stream.size() * sizeof(float));
+
+        writer.write(mesh.bones_indices_type);
+        writer.write_blob(mesh.bones_indices.data(), mesh.bones_indices.size());
+
+        writer.write_blob(mesh.indicies.data(), mesh.indicies.size() * sizeof(unsigned int));
+        writer.write_blob(mesh.indicies_16.data(), mesh.indicies_16.size() * sizeof(uint16_t));
+
+        writer.write((uint64_t)mesh.lods.size());
+        for (auto& lod : mesh.lods)
+        {
+            writer.write(lod.ratio);
+            writer.write(lod.error);
+            writer.write_blob(lod.indicies.data(), lod.indicies.size() * sizeof(unsigned int));
+        }
+
+        writer.write_blob(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(model::mesh::meshlet));
+        writer.write_blob(mesh.meshlet_vertices.data(), mesh.meshlet_vertices.size() * sizeof(unsigned int));
+        writer.write_blob(mesh.meshlet_triangles.data(), mesh.meshlet_triangles.size());
+
+        writer.write_blob(mesh.storage, mesh.storage_size);
+        writer.write_blob(mesh.layout.data(), mesh.layout.size() * sizeof(model::attribute_layout));
+        writer.write((uint64_t)mesh.indicies_offset);
+        writer.write((uint64_t)mesh.indicies_count);
+    }
+
+    writer.write((uint64_t)mod.nodes.size());
+    for (auto& node : mod.nodes)
+    {
+        writer.write((uint64_t)node.name.size());
+        writer.write(node.name.data(), node.name.size());
+        writer.write(node.parent);
+        writer.write(node.transform);
+        writer.write_blob(node.meshes.data(), node.meshes.size() * sizeof(unsigned int));
+    }
+
+    write_cooked_file(path, writer.bytes);
+}
+
+result<model> read_cooked_model(const std::string& path, uint64_t key)
+{
+    mapped_file file;
+    if (!map_file(path.c_str(), file, true))
+        return {false, {}};
+
+    model output;
+    output.mapping = const_cast<void*>(file.data);
+    output.mapping_size = file.size;
+    byte_reader reader{static_cast<const uint8_t*>(file.data), file.size};
+
+    const uint8_t* magic = reader.read(sizeof(cooked_model_magic));
+    const bool valid = magic
+        && std::memcmp(magic, cooked_model_magic, sizeof(cooked_model_magic)) == 0
+        && reader.read<uint32_t>() == cooked_model_version
+        && reader.read<uint64_t>() == key;
+
+    if (!valid)
+    {
+        free_model(output);
+        return {false, {}};
+    }
+
+    const size_t bones_count = (size_t)reader.read<uint64_t>();
+    for (size_t b = 0; b < bones_count && !reader.failed; b++)
+    {
+        const size_t name_size = (size_t)reader.read<uint64_t>();
+        const uint8_t* name = reader.read(name_size);
+
+        model::bone_info bone;
+        bone.id = reader.read<int>();
+        bone.offset_matrix_row_0 = reader.read<std::array<float, 4>>();
+        bone.offset_matrix_row_1 = reader.read<std::array<float, 4>>();
+        bone.offset_matrix_row_2 = reader.read<std::array<float, 4>>();
+        bone.offset_matrix_row_3 = reader.read<std::array<float, 4>>();
+
+        if (name)
+            output.bones.insert({std::string(reinterpret_cast<const char*>(name), name_size), bone});
+    }
+
+    const size_t meshes_count = (size_t)reader.read<uint64_t>();
+    if (!reader.failed && meshes_count <= file.size)
+        output.meshes.resize(meshes_count);
+
+    for (auto& mesh : output.meshes)
+    {
+        const size_t attributes_count = (size_t)reader.read<uint64_t>();
+        for (size_t a = 0; a < attributes_count && !reader.failed; a++)
+            mesh.attributes.insert(reader.read<model::attribute>());
+
+        mesh.material_id = reader.read<int>();
+        mesh.primitives = reader.read<model::primitive_type>();
+        mesh.vertices_count = (size_t)reader.read<uint64_t>();
+        mesh.statistics = reader.read<model::mesh_statistics>();
+        mesh.bounds = reader.read<model::bounding_volume>();
+        mesh.indicies_type = reader.read<model::component_type>();
+
+        const size_t streams_count = (size_t)reader.read<uint64_t>();
+        for (size_t v = 0; v < streams_count && !reader.failed; v++)
+        {
+            mesh.vertices.push_back({});
+            reader.read_vector(mesh.vertices.back());
+        }
+
+        mesh.bones_indices_type = reader.read<model::component_type>();
+        reader.read_vector(mesh.bones_indices);
+
+        reader.read_vector(mesh.indicies);
+        reader.read_vector(mesh.indicies_16);
+
+        const size_t lods_count = (size_t)reader.read<uint64_t>();
+        for (size_t l = 0; l < lods_count && !reader.failed; l++)
+        {
+            model::mesh::lod lod;
+            lod.ratio = reader.read<float>();
+            lod.error = reader.read<float>();
+            reader.read_vector(lod.indicies);
+            mesh.lods.push_back(std::move(lod));
+        }
+
+        reader.read_vector(mesh.meshlets);
+        reader.read_vector(mesh.meshlet_vertices);
+        reader.read_vector(mesh.meshlet_triangles);
+
+        //Blobs are aligned like storage_alignment within the mapping
+        size_t storage_size;
+        const uint8_t* storage = reader.read_blob(storage_size);
+        if (storage && storage_size)
+        {
+            mesh.storage = const_cast<uint8_t*>(storage);
+            mesh.storage_size = storage_size;
+        }
+
+        reader.read_vector(mesh.layout);
+        mesh.indicies_offset = (size_t)reader.read<uint64_t>();
+        mesh.indicies_count = (size_t)reader.read<uint64_t>();
+
+        if (reader.failed)
+            break;
+    }
+
+    const size_t nodes_count = (size_t)reader.read<uint64_t>();
+    for (size_t n = 0; n < nodes_count && !reader.failed; n++)
+    {
+        const size_t name_size = (size_t)reader.read<uint64_t>();
+        const uint8_t* name = reader.read(name_size);
+
+        model::node node;
+        node.name = name ? std::string(reinterpret_cast<const char*>(name), name_size) : std::string();
+        node.parent = reader.read<int>();
+        node.transform = reader.read<std::array<std::array<float, 4>, 4>>();
+        reader.read_vector(node.meshes);
+
+        output.nodes.push_back(std::move(node));
+    }
+
+    if (reader.failed)
+    {
+        free_model(output);
+        return {false, {}};
+    }
+
+    //Only contiguous storage points into the mapping
+    if (std::none_of(output.meshes.begin(), output.meshes.end(), [](const model::mesh& mesh){ return mesh.storage; }))
+    {
+        unmap_file(file);
+        output.mapping = nullptr;
+        output.mapping_size = 0;
+    }
+
+    aggregate_model_bounds(output);
+
+    return {true, std::move(output)};
+}
+
+//Imports with the given importer, or a temporary one when it is null
+result<model> load_model_reporting(
+    Assimp::Importer*           importer,
+    const char*                 filepath,
+    const void*                 memory,
+    size_t                      memory_size,
+    const char*                 format_hint,
+    const model_load_settings&  settings,
+    load_progress*              progress
+)
+{
+    uint64_t key = 0;
+
+    if (filepath && !settings.cache_directory.empty())
+    {
+        key = hash_value(14695981039346656037ull, cooked_model_version);
+        key = hash_model_load_settings(key, settings);
+        key = hash_source_file(key, filepath);
+    }
+
+    const std::string cooked_path = key ? cooked_file_path(settings.cache_directory, key, ".gllmodel") : std::string();
+
+    if (key)
+    {
+        auto cooked = read_cooked_model(cooked_path, key);
+
+        if (cooked.first && progress)
+        {
+            progress->meshes_total = cooked.second.meshes.size();
+            progress->meshes_converted = cooked.second.meshes.size();
+        }
+
+        if (cooked.first)
+            return cooked;
+    }
+
+    std::unique_ptr<Assimp::Importer> temporary;
+    if (!importer)
+    {
+        temporary = std::make_unique<Assimp::Importer>();
+        importer = temporary.get();
+    }
+
+    auto output = import_model(*importer, filepath, memory, memory_size, format_hint, settings, progress);
+
+    if (key && output.first)
+        write_cooked_model(cooked_path, key, output.second);
+
+    return output;
+}
+
+result<model> gll::load_model(const char* filepath, const model_load_settings& settings)
+{
+    return load_model_reporting(nullptr, filepath, nullptr, 0, nullptr, settings, nullptr);
+}
+
+result<model> gll::load_model(const void* data, size_t size, const char* format_hint, const model_load_settings& settings)
+{
+    return load_model_reporting(nullptr, nullptr, data, size, format_hint, settings, nullptr);
+}
+
+struct model_loader::state
+{
+    Assimp::Importer import;
+};
+
+model_loader::model_loader() : impl(new state()) {}
+
+model_loader::~model_loader() = default;
+
+result<model> model_loader::load(const char* filepath, const model_load_settings& settings)
+{
+    return load_model_reporting(&impl->import, filepath, nullptr, 0, nullptr, settings, nullptr);
+}
+
+result<model> model_loader::load(const void* data, size_t size, const char* format_hint, const model_load_settings& settings)
+{
+    return load_model_reporting(&impl->import, nullptr, data, size, format_hint, settings, nullptr);
+}
+
+void gll::free_model(model& mod)
+{
+    const uint8_t* mapping = static_cast<const uint8_t*>(mod.mapping);
+
+    for (auto& mesh : mod.meshes)
+    {
+        const uint8_t* storage = static_cast<const uint8_t*>(mesh.storage);
+        const bool mapped = mapping && storage >= mapping && storage < mapping + mod.mapping_size;
+
+        if (mesh.storage && !mapped)
+            ::operator delete(mesh.storage, std::align_val_t(model::mesh::storage_alignment));
+
+        mesh.storage = nullptr;
+        mesh.storage_size = 0;
+    }
+
+    if (mod.mapping)
+    {
+        mapped_file file{mod.mapping, mod.mapping_size};
+        unmap_file(file);
+    }
+
+    mod.mapping = nullptr;
+    mod.mapping_size = 0;
+}
+
+//Asynchronous loading
+
+template<class T, class F>
+async_result<T> launch_async_load(F load, std::function<void(result<T>&)> on_complete)
+{
+    async_result<T> handle;
+    handle.progress = std::make_shared<load_progress>();
+
+    std::promise<result<T>> promise;
+    handle.future = promise.get_future();
+
+    //Exceptions of the load and the callback are handed to the future
+    worker_pool::get().launch([load = std::move(load), on_complete = std::move(on_complete), progress = handle.progress, promise = std::move(promise)]() mutable {
+        try
+        {
+            result<T> output = load(progress.get());
+
+            if (on_complete)
+                on_complete(output);
+
+            promise.set_value(std::move(output));
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+    });
+
+    return handle;
+}
+
+async_result<image> gll::load_image_async(
+    const char*                                 filepath,
+    const image_load_settings&                  settings,
+    std::function<void(result<image>&)>         on_complete
+)
+{
+    return launch_async_load<image>(
+        [path = std::string(filepath), settings](load_progress* progress){
+            return load_image_reporting(path.c_str(), nullptr, 0, settings, progress);
+        },
+        std::move(on_complete)
+    );
+}
+
+async_result<model> gll::load_model_async(
+    const char*                                 filepath,
+    const model_load_settings&                  settings,
+    std::function<void(result<model>&)>         on_complete
+)
+{
+    return launch_async_load<model>(
+        [path = std::string(filepath), settings](load_progress* progress){
+            return load_model_reporting(nullptr, path.c_str(), nullptr, 0, nullptr, settings, progress);
+        },
+        std::move(on_complete)
+    );
 }
 
 #endif